@@ -1,6 +1,8 @@
 const express = require("express");
 const bodyParser = require("body-parser");
 const binding = require("bindings")("native");
+const { getSimulationArguments } = require("./simulationArguments");
+const { lookUpRun, getCachedRun, finishRun } = require("./resultCache");
 
 const app = express();
 
@@ -19,43 +21,133 @@ app.use((req, res, next) => {
   next();
 });
 
-async function getSimulationStatus() {
-  const data = await binding.getSimulationStatus();
+async function getSimulationStatus(jobId) {
+  const data = await binding.getSimulationStatus(jobId);
   return data;
 }
 
+// Without a jobId this reports the most recently started job
 app.post("/api/getSimulationStatus", (req, res, next) => {
-  getSimulationStatus().then((data) => {
+  getSimulationStatus(req.body.jobId).then((data) => {
     res.status(200).json({
+      jobId: data.jobId,
+      state: data.state,
+      threads: data.threads,
+      runningJobs: data.runningJobs,
+      poolSize: data.poolSize,
       currentSimulationNumber: data.currentSimulationNumber,
-      numberOfSimulations: data.numberOfSimulations
+      numberOfSimulations: data.numberOfSimulations,
+      handRanksLoaded: data.handRanksLoaded,
+      handRanksMapped: data.handRanksMapped,
+      handRanksHugePages: data.handRanksHugePages,
+      handRanksNumaNodes: data.handRanksNumaNodes,
+      handRanksBytes: data.handRanksBytes,
+      handRanksLoadMs: data.handRanksLoadMs,
+      handRanksError: data.handRanksError
     });
   });
 });
 
-const uthSimulationResponse = (res) => (profit, edge, stDev, cards, error) => {
+app.post("/api/listSimulations", (req, res, next) => {
+  res.status(200).json(binding.listSimulations());
+});
+
+app.post("/api/cancelSimulation", (req, res, next) => {
+  res.status(200).json({ cancelled: binding.cancelSimulation(req.body.jobId) });
+});
+
+const uthSimulationResponse = (res, lookup, numberOfSimulations) => (profit, edge, stDev, cards, error) => {
   if (error) {
     res.status(500).json({ message: error });
   } else {
-    res.status(200).json({
-      profit, edge, stDev, ...cards
-    });
+    res.status(200).json(finishRun(lookup, numberOfSimulations, profit, edge, stDev, cards));
   }
 }
 
-async function runUthSimulations(res, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays) {
-  const data = await binding.runUthSimulations([], numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, uthSimulationResponse(res));
+async function runUthSimulations(res, lookup, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options) {
+  const data = await binding.runUthSimulations([], numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, uthSimulationResponse(res, lookup, numberOfSimulations));
   return data;
 }
 
+// Repeated runs come from the result cache, and longer runs of a cached one
+// only play the extra hands. The response's cache field says which happened.
 app.post("/api/runUthSimulations", (req, res, next) => {
-  const { numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays } = req.body;
-  // Use default values if not provided
-  const dealerCards = knownDealerCards !== undefined ? knownDealerCards : 0;
-  const flopCards = knownFlopCards !== undefined ? knownFlopCards : 0;
-  const turnRiverCards = knownTurnRiverCards !== undefined ? knownTurnRiverCards : 0;
-  const excludeFishy = excludeFishyPlays !== undefined ? excludeFishyPlays : false;
-  runUthSimulations(res, numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy);
+  const args = getSimulationArguments(req.body);
+  const [numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options] = args;
+  const lookup = lookUpRun(args);
+  if (lookup.result) {
+    res.status(200).json(getCachedRun(lookup, numberOfSimulations));
+    return;
+  }
+  runUthSimulations(res, lookup, numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options);
+});
+
+// Same as runUthSimulations, but streams newline-delimited JSON: a "progress"
+// event at each update pushed by the worker, then a "result" or "error" event.
+// Closing the connection early cancels the simulation.
+app.post("/api/streamUthSimulations", (req, res, next) => {
+  const args = getSimulationArguments(req.body);
+  const [numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options] = args;
+  const lookup = lookUpRun(args);
+  res.status(200);
+  res.setHeader("Content-Type", "application/x-ndjson");
+  res.setHeader("Cache-Control", "no-cache");
+  res.flushHeaders();
+  const send = (event) => res.write(JSON.stringify(event) + "\n");
+  if (lookup.result) {
+    send({ type: "result", ...getCachedRun(lookup, numberOfSimulations) });
+    res.end();
+    return;
+  }
+  options.onProgress = (progress) => send({ type: "progress", ...progress });
+  const jobId = binding.runUthSimulations([], numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options, (profit, edge, stDev, cards, error) => {
+    if (res.writableEnded) return;
+    send(error ? { type: "error", message: error } : { type: "result", ...finishRun(lookup, numberOfSimulations, profit, edge, stDev, cards) });
+    res.end();
+  });
+  res.on("close", () => {
+    if (!res.writableEnded) binding.cancelSimulation(jobId);
+  });
+});
+
+// Exact EVs of the actions on one street of a partly known hand. cards is in
+// deck order (five community, two player, two dealer) with 0 for unknown cards.
+app.post("/api/getHandEvs", (req, res, next) => {
+  const { cards, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, street, strategy, threads } = req.body;
+  const options = {};
+  if (street !== undefined) options.street = street;
+  if (strategy !== undefined) options.strategy = strategy;
+  if (threads !== undefined) options.threads = threads;
+  binding.getHandEvs(cards || [], knownDealerCards || 0, knownFlopCards || 0, knownTurnRiverCards || 0, excludeFishyPlays || false, options, (evs) => {
+    if (evs.error) {
+      res.status(400).json({ message: evs.error });
+    } else {
+      res.status(200).json(evs);
+    }
+  });
+});
+
+// Searches a strategy's thresholds on one set of deals. Takes the body of
+// runUthSimulations, with the strategy as a template, plus the parameters to
+// search, the most rounds and the validationHands to check the winner on.
+app.post("/api/optimizeStrategy", (req, res, next) => {
+  const [numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options] = getSimulationArguments(req.body);
+  const { parameters, rounds, validationHands } = req.body;
+  if (parameters !== undefined) options.parameters = parameters;
+  if (rounds !== undefined) options.rounds = rounds;
+  if (validationHands !== undefined) options.validationHands = validationHands;
+  binding.optimizeStrategy(numberOfSimulations, dealerCards, flopCards, turnRiverCards, excludeFishy, options, (optimized) => {
+    if (optimized.error) {
+      res.status(400).json({ message: optimized.error });
+    } else {
+      res.status(200).json(optimized);
+    }
+  });
+});
+
+// Arguments getSimulationArguments won't accept, such as a bad checkpoint name
+app.use((error, req, res, next) => {
+  res.status(400).json({ message: error.message });
 });
 
 module.exports = app;
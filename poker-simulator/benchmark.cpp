@@ -0,0 +1,197 @@
+// Native benchmarks of the evaluator and simulation kernels, with no Node
+// dependency. Prints one JSON object, so runs from different builds can be
+// compared to catch regressions:
+//
+//   benchmark [--hands 2000000] [--threads 1,2,4,8] [--scenarios 0-0-0,1-1-0,2-1-2]
+//
+// Kernels run on one thread over the same pre-dealt hands. End-to-end runs
+// play each scenario at each thread count, and scaling efficiency is the
+// speed-up over the fewest threads divided by the increase in threads.
+#ifndef UTH_NO_NAPI
+#define UTH_NO_NAPI // binding.gyp's benchmark target defines it already
+#endif
+#include "binding.cpp"
+
+// Pre-dealt hands the kernels cycle through: community, player, dealer
+const int BENCHMARK_DEALS = 1 << 16;
+
+struct benchmarkScenario
+{
+  int knownDealerCards;
+  int knownFlopCards;
+  int knownTurnRiverCards;
+};
+
+string getScenarioName(const benchmarkScenario &scenario)
+{
+  return std::to_string(scenario.knownDealerCards) + "-" + std::to_string(scenario.knownFlopCards) + "-" + std::to_string(scenario.knownTurnRiverCards);
+}
+
+vector<string> splitList(const string &list)
+{
+  vector<string> items;
+  size_t start = 0;
+  while (start <= list.size())
+  {
+    size_t end = list.find(',', start);
+    if (end == string::npos)
+      end = list.size();
+    if (end > start)
+      items.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+string getTimingJson(int64_t hands, double seconds)
+{
+  char json[160];
+  snprintf(json, sizeof(json), "\"hands\": %lld, \"seconds\": %.6f, \"handsPerSecond\": %.1f, \"nsPerHand\": %.3f",
+           (long long)hands, seconds, seconds > 0 ? hands / seconds : 0.0, hands > 0 ? seconds * 1e9 / hands : 0.0);
+  return json;
+}
+
+// Times kernel over hands of the pre-dealt hands, adding what it returns to
+// checksum so the work can't be optimized away
+template <class Kernel>
+string benchmarkKernel(const string &name, const vector<int> &deals, int64_t hands, int64_t &checksum, Kernel kernel)
+{
+  auto start = chrono::steady_clock::now();
+  int64_t sum = 0;
+  for (int64_t i = 0; i < hands; i++)
+    sum += kernel(&deals[(i % BENCHMARK_DEALS) * DEALT_CARDS], i);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  checksum += sum;
+  return "{\"name\": \"" + name + "\", " + getTimingJson(hands, seconds) + "}";
+}
+
+int main(int argc, char **argv)
+{
+  int64_t hands = 2000000;
+  vector<int> threadCounts;
+  vector<benchmarkScenario> scenarios = {{0, 0, 0}, {1, 1, 0}, {2, 1, 2}};
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    string flag = argv[i];
+    if (flag == "--hands")
+      hands = max<int64_t>(1, atoll(argv[i + 1]));
+    else if (flag == "--threads")
+    {
+      for (const string &item : splitList(argv[i + 1]))
+        threadCounts.push_back(max(1, atoi(item.c_str())));
+    }
+    else if (flag == "--scenarios")
+    {
+      scenarios.clear();
+      for (const string &item : splitList(argv[i + 1]))
+      {
+        benchmarkScenario scenario{0, 0, 0};
+        sscanf(item.c_str(), "%d-%d-%d", &scenario.knownDealerCards, &scenario.knownFlopCards, &scenario.knownTurnRiverCards);
+        scenarios.push_back(scenario);
+      }
+    }
+  }
+  // A job never gets more threads than the pool has, so larger counts would
+  // only time the pool again under another name
+  threadCounts.erase(remove_if(threadCounts.begin(), threadCounts.end(), [](int threads)
+                               { return threads > getPoolSize(); }),
+                     threadCounts.end());
+  if (threadCounts.empty())
+  {
+    for (int threads = 1; threads < getPoolSize(); threads *= 2)
+      threadCounts.push_back(threads);
+    threadCounts.push_back(getPoolSize());
+  }
+  if (!loadHandRanks())
+  {
+    printf("{\"error\": \"%s\"}\n", HR_info.error.c_str());
+    return 1;
+  }
+  getPreflopRaiseTables();
+
+  vector<int> deals(BENCHMARK_DEALS * DEALT_CARDS);
+  vector<int> deck(baseDeck, baseDeck + 52);
+  int swaps[DEALT_CARDS];
+  for (int deal = 0; deal < BENCHMARK_DEALS; deal++)
+  {
+    splitMixRng rng(1, deal);
+    dealCards(deck.data(), swaps, rng);
+    copy(deck.begin(), deck.begin() + DEALT_CARDS, deals.begin() + deal * DEALT_CARDS);
+    undealCards(deck.data(), swaps);
+  }
+
+  int64_t checksum = 0;
+  vector<string> kernels;
+  kernels.push_back(benchmarkKernel("shuffle", deals, hands, checksum, [&](const int *, int64_t i)
+                                    {
+                                      splitMixRng rng(2, i);
+                                      dealCards(deck.data(), swaps, rng);
+                                      int first = deck[0];
+                                      undealCards(deck.data(), swaps);
+                                      return first; }));
+  kernels.push_back(benchmarkKernel("LookupHandFast", deals, hands, checksum, [](const int *hand, int64_t)
+                                    { return LookupHandFast(hand); }));
+  kernels.push_back(benchmarkKernel("FiveCardLookupFast", deals, hands, checksum, [](const int *hand, int64_t)
+                                    { return FiveCardLookupFast(hand); }));
+  // Outs are counted in full rather than stopping at a threshold
+  kernels.push_back(benchmarkKernel("getBadOuts", deals, hands, checksum, [](const int *hand, int64_t)
+                                    {
+                                      handState board = handState().extend(hand, 5);
+                                      return getBadOuts(hand + 5, getCardMask(hand, 7), board, 52); }));
+  kernels.push_back(benchmarkKernel("getGoodOuts", deals, hands, checksum, [](const int *hand, int64_t)
+                                    {
+                                      handState board = handState().extend(hand, 5);
+                                      return getGoodOuts(hand + 5, hand[7], getCardMask(hand, 7), board, 52); }));
+  for (const benchmarkScenario &scenario : scenarios)
+  {
+    kernels.push_back(benchmarkKernel("getPlayBet " + getScenarioName(scenario), deals, hands, checksum, [&](const int *hand, int64_t)
+                                      { return getPlayBet<handState>(nullptr, hand + 5, hand, hand + 7, scenario.knownDealerCards, scenario.knownFlopCards, scenario.knownTurnRiverCards, false); }));
+  }
+
+  vector<string> simulations;
+  for (const benchmarkScenario &scenario : scenarios)
+  {
+    // Warm up first, so paging in and first fills aren't charged to the
+    // fewest threads
+    simulationOptions warmUp;
+    warmUp.hasSeed = true;
+    warmUp.seed = 1;
+    warmUp.threads = threadCounts[0];
+    runUthSimulations({}, max<int64_t>(1, hands / 10), 100, scenario.knownDealerCards, scenario.knownFlopCards, scenario.knownTurnRiverCards, false, warmUp);
+    double fewestThreadsRate = 0;
+    for (size_t t = 0; t < threadCounts.size(); t++)
+    {
+      simulationOptions options;
+      options.hasSeed = true;
+      options.seed = 1;
+      options.threads = threadCounts[t];
+      auto start = chrono::steady_clock::now();
+      result played = runUthSimulations({}, hands, 100, scenario.knownDealerCards, scenario.knownFlopCards, scenario.knownTurnRiverCards, false, options);
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      double rate = seconds > 0 ? played.hands / seconds : 0;
+      if (t == 0)
+        fewestThreadsRate = rate;
+      double efficiency = fewestThreadsRate > 0 ? rate / fewestThreadsRate * threadCounts[0] / threadCounts[t] : 0;
+      checksum += (int64_t)(played.profit * 2);
+      char extra[160];
+      snprintf(extra, sizeof(extra), ", \"threads\": %d, \"scalingEfficiency\": %.4f, \"edge\": %.10f", threadCounts[t], efficiency, played.edge);
+      // Each NUMA node's rate, with HANDRANKS_NUMA=1
+      string numaRates;
+      for (const numaNodeCounts &node : played.numaNodes)
+        numaRates += (numaRates.empty() ? "" : ", ") + std::to_string(node.seconds > 0 ? node.hands / node.seconds : 0.0);
+      if (!numaRates.empty())
+        numaRates = ", \"numaHandsPerSecond\": [" + numaRates + "]";
+      simulations.push_back("{\"scenario\": \"" + getScenarioName(scenario) + "\", " + getTimingJson(played.hands, seconds) + extra + numaRates + "}");
+    }
+  }
+
+  printf("{\n  \"hands\": %lld,\n  \"poolThreads\": %d,\n  \"handRanksMapped\": %s,\n  \"handRanksNumaNodes\": %d,\n  \"kernels\": [\n", (long long)hands, getPoolSize(),
+         HR_info.mapped ? "true" : "false", HR_info.numaNodes);
+  for (size_t i = 0; i < kernels.size(); i++)
+    printf("    %s%s\n", kernels[i].c_str(), i + 1 < kernels.size() ? "," : "");
+  printf("  ],\n  \"simulations\": [\n");
+  for (size_t i = 0; i < simulations.size(); i++)
+    printf("    %s%s\n", simulations[i].c_str(), i + 1 < simulations.size() ? "," : "");
+  printf("  ],\n  \"checksum\": %lld\n}\n", (long long)checksum);
+  return 0;
+}
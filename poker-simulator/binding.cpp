@@ -1,31 +1,238 @@
+// UTH_NO_NAPI leaves out the Node bindings, for native tools such as
+// benchmark.cpp that build the engine on its own
+#ifndef UTH_NO_NAPI
 #include <napi.h>
+#endif
 #include <iostream>
 #include <random>
 #include <numeric>
 #include <atomic>
 #include "omp.h"
 #include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <future>
+#include <type_traits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <xmmintrin.h>
+#elif defined(UTH_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
+#ifndef UTH_NO_NAPI
 using namespace Napi;
+#endif
 using namespace std;
 
+// FORCE_INLINE is __forceinline for MSVC and the attribute for GCC and Clang
+#ifdef _MSC_VER
+#define FORCE_INLINE __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+// Thread-locals read in the hot loops go in the module's static TLS block,
+// so reading one is a load rather than a call into the dynamic loader
+#if defined(__GNUC__) && !defined(_WIN32)
+#define INITIAL_EXEC_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define INITIAL_EXEC_TLS
+#endif
+
+// The batch kernels (dealing, play bet decisions with their outs counting,
+// and the showdown lookups) are built for AVX-512, AVX2 and baseline x86-64
+// where GCC can clone them, and glibc picks the clone for the CPU when the
+// module loads. Elsewhere they're built once, for the compiler's target.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11 && defined(__x86_64__) && defined(__linux__) && !defined(UTH_NO_DISPATCH)
+#define DISPATCHED_KERNEL __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define DISPATCHED_KERNEL
+#endif
+
 #define DWORD int32_t
 
 const int ROYAL_FLUSH = 36874;
 
-// The handranks lookup table- loaded from HANDRANKS.DAT.
-// Align to 64-byte boundary for better cache utilization
-__declspec(align(64)) int HR[32487834];
-bool HR_loaded = false;
+// Building with UTH_COUNT_ALLOCATIONS replaces the global operator new to
+// count heap allocations per thread, so runs can report allocations per hand
+#ifdef UTH_COUNT_ALLOCATIONS
+thread_local int64_t threadAllocations = 0;
+
+void *operator new(size_t size)
+{
+  threadAllocations++;
+  void *memory = malloc(size ? size : 1);
+  if (!memory)
+    throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  free(memory);
+}
+
+inline int64_t getThreadAllocations()
+{
+  return threadAllocations;
+}
+#else
+inline int64_t getThreadAllocations()
+{
+  return -1;
+}
+#endif
+
+// Building with UTH_PROFILE counts, per thread, the play bets made, the
+// outs loops run and left early, and the HandRanks lookups, and times the
+// phases of one Monte Carlo batch in every PROFILE_SAMPLE_BATCHES with the
+// cycle counter. Without it the PROFILE_ macros expand to nothing.
+enum profileCounter
+{
+  PROFILE_FOLDS,
+  PROFILE_CALLS_1X,
+  PROFILE_BETS_2X,
+  PROFILE_RAISES_4X,
+  PROFILE_BAD_OUTS_CALLS,
+  PROFILE_BAD_OUTS_EARLY_EXITS,
+  PROFILE_GOOD_OUTS_CALLS,
+  PROFILE_GOOD_OUTS_EARLY_EXITS,
+  PROFILE_HAND_RANK_LOOKUPS,
+  PROFILE_COUNTERS
+};
+
+enum profilePhase
+{
+  PHASE_SHUFFLE,
+  PHASE_PLAY_BET,
+  PHASE_SHOWDOWN,
+  PHASE_SCORING,
+  PROFILE_PHASES
+};
+
+const int PROFILE_SAMPLE_BATCHES = 16;
+
+struct profileCounts
+{
+  int64_t counters[PROFILE_COUNTERS] = {};
+  int64_t cycles[PROFILE_PHASES] = {};
+  int64_t sampledHands = 0; // In the timed batches
+
+  void add(const profileCounts &other, int64_t sign = 1)
+  {
+    for (int i = 0; i < PROFILE_COUNTERS; i++) counters[i] += sign * other.counters[i];
+    for (int i = 0; i < PROFILE_PHASES; i++) cycles[i] += sign * other.cycles[i];
+    sampledHands += sign * other.sampledHands;
+  }
+};
+
+#ifdef UTH_PROFILE
+const bool PROFILED = true;
+thread_local profileCounts threadProfile;
+
+inline uint64_t readCycles()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+#define PROFILE_COUNT(counter) (threadProfile.counters[counter]++)
+#define PROFILE_ADD(counter, count) (threadProfile.counters[counter] += (count))
+#define PROFILE_BATCH_START(batchNumber)                                    \
+  bool profileTimed = (batchNumber) % PROFILE_SAMPLE_BATCHES == 0; \
+  uint64_t profileStart = profileTimed ? readCycles() : 0
+#define PROFILE_PHASE_END(phase)                           \
+  if (profileTimed)                                        \
+  {                                                        \
+    uint64_t profileNow = readCycles();                    \
+    threadProfile.cycles[phase] += profileNow - profileStart; \
+    profileStart = profileNow;                             \
+  }
+#define PROFILE_BATCH_END(hands) \
+  if (profileTimed)              \
+  threadProfile.sampledHands += (hands)
+#else
+const bool PROFILED = false;
+#define PROFILE_COUNT(counter)
+#define PROFILE_ADD(counter, count)
+#define PROFILE_BATCH_START(batchNumber)
+#define PROFILE_PHASE_END(phase)
+#define PROFILE_BATCH_END(hands)
+#endif
 
+// The handranks lookup table- memory-mapped read-only from HANDRANKS.DAT so
+// every simulator process on the box shares one page-cache copy of it.
+const int64_t HR_ENTRIES = 32487834;
+const int *HR = nullptr;
+std::atomic<bool> HR_loaded{false};
+std::mutex HR_mutex;
 
+// How the handranks table was brought in, reported by GetSimulationStatus
+struct handRanksInfo
+{
+  bool mapped;    // HR points straight at the shared read-only file mapping
+  bool hugePages; // HR is a private copy backed by huge pages
+  int64_t bytes;
+  double loadMs;
+  string error;
+  int numaNodes = 0; // Nodes with a replica of their own, 0 without HANDRANKS_NUMA
+};
+handRanksInfo HR_info{false, false, 0, 0, ""};
 
-auto rng = std::default_random_engine{std::random_device{}()};
-int64_t currentSimulationNumber;
-int64_t numberOfSimulations;
-std::atomic<int64_t> atomicCurrentSimulationNumber{0}; // Thread-safe progress counter
+// With HANDRANKS_NUMA=1 on a multi-socket Linux host, every NUMA node with
+// CPUs gets a private copy of the table in its own memory. Pool threads are
+// pinned to the nodes in turn and read their node's copy, so no lookup has
+// to cross to another socket. Filled in by loadHandRanks before HR_loaded.
+const int MAX_NUMA_NODES = 64;
+struct numaReplicas
+{
+  int nodes = 0;
+  int ids[MAX_NUMA_NODES];              // The system's node numbers
+  const int *tables[MAX_NUMA_NODES];
+  vector<vector<int>> cpus;             // Of each node
+};
+numaReplicas HR_numa;
 
+// The table the lookups on each thread read: HR, or the thread's NUMA node
+// replica once useNumaNode has pointed it there
+thread_local INITIAL_EXEC_TLS const int *const *threadHandRanks = &HR;
 
+FORCE_INLINE const int *getHandRanks()
+{
+  return *threadHandRanks;
+}
 
 // Pre-allocated deck array to avoid reallocation
 const int baseDeck[52] = {1, 2, 3, 4, 5, 6, 7, 8,
@@ -37,751 +244,5132 @@ const int baseDeck[52] = {1, 2, 3, 4, 5, 6, 7, 8,
                           44, 45, 46, 47, 48, 49, 50,
                           51, 52};
 
-// Load HR array once and cache it
-bool loadHandRanks()
-{
-  if (HR_loaded)
-    return true;
-  
-  memset(HR, 0, sizeof(HR));
-  FILE *fin = fopen("HandRanks.dat", "rb");
-  if (!fin)
-    return false;
-  size_t bytesread = fread(HR, sizeof(HR), 1, fin);
-  std::fclose(fin);
-  HR_loaded = true;
-  return true;
-}
+// Only the first 9 cards of a shuffled deck are ever used: 5 community cards,
+// 2 player cards and 2 dealer cards
+const int DEALT_CARDS = 9;
 
-void print(std::vector<int> const &input)
+inline uint64_t mix64(uint64_t z)
 {
-  std::copy(input.begin(),
-            input.end(),
-            std::ostream_iterator<int>(std::cout, " "));
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
 }
 
-void printError(std::vector<int> const &input)
-{
-  std::copy(input.begin(),
-            input.end(),
-            std::ostream_iterator<int>(std::cerr, " "));
-}
+// Counter-based generators: the stream for a hand is a pure function of the
+// seed and the hand's index, so a run doesn't depend on which thread dealt
+// which hand and any hand can be regenerated without the ones before it.
 
-// This function isn't currently used, but shows how you lookup
-// a 7-card poker hand. pCards should be a pointer to an array
-// of 7 integers each with value between 1 and 52 inclusive.
-int LookupHand(vector<int> cards)
+// SplitMix64 started from a hash of the seed and hand index
+struct splitMixRng
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  p = HR[p + cards[5]];
-  return HR[p + cards[6]];
-}
+  uint64_t state;
+  uint64_t buffer;
+  bool buffered;
 
-// Optimized version using raw array pointer for better performance
-__forceinline int LookupHandFast(const int* cards)
+  splitMixRng(uint64_t seed, uint64_t hand) : state(mix64(seed + mix64(hand + 0x9E3779B97F4A7C15ULL))), buffer(0), buffered(false) {}
+
+  uint32_t next()
+  {
+    if (buffered)
+    {
+      buffered = false;
+      return (uint32_t)(buffer >> 32);
+    }
+    buffer = mix64(state += 0x9E3779B97F4A7C15ULL);
+    buffered = true;
+    return (uint32_t)buffer;
+  }
+};
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3") with the hand index as counter and the seed as key
+struct philoxRng
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  p = HR[p + cards[5]];
-  return HR[p + cards[6]];
-}
+  uint32_t key[2];
+  uint32_t counter[4];
+  uint32_t output[4];
+  int used;
+
+  philoxRng(uint64_t seed, uint64_t hand) : used(4)
+  {
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+    counter[0] = (uint32_t)hand;
+    counter[1] = (uint32_t)(hand >> 32);
+    counter[2] = 0;
+    counter[3] = 0;
+  }
 
+  void generate()
+  {
+    uint32_t x[4] = {counter[0], counter[1], counter[2], counter[3]};
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (int round = 0; round < 10; round++)
+    {
+      uint64_t product0 = (uint64_t)0xD2511F53 * x[0];
+      uint64_t product1 = (uint64_t)0xCD9E8D57 * x[2];
+      uint32_t y0 = (uint32_t)(product1 >> 32) ^ x[1] ^ k0;
+      uint32_t y2 = (uint32_t)(product0 >> 32) ^ x[3] ^ k1;
+      x[0] = y0;
+      x[1] = (uint32_t)product1;
+      x[2] = y2;
+      x[3] = (uint32_t)product0;
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    copy(x, x + 4, output);
+    counter[2]++;
+    used = 0;
+  }
 
+  uint32_t next()
+  {
+    if (used == 4)
+      generate();
+    return output[used++];
+  }
+};
 
-__forceinline int FiveCardLookupFast(const int* cards)
+// Unbiased integer in [0, range) (Lemire, "Fast random integer generation in
+// an interval"), without the modulo bias of next() % range
+template <class Rng>
+inline uint32_t boundedRandom(Rng &rng, uint32_t range)
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  return HR[p];
+  uint64_t product = (uint64_t)rng.next() * range;
+  uint32_t low = (uint32_t)product;
+  if (low < range)
+  {
+    uint32_t threshold = (uint32_t)(-range) % range;
+    while (low < threshold)
+    {
+      product = (uint64_t)rng.next() * range;
+      low = (uint32_t)product;
+    }
+  }
+  return (uint32_t)(product >> 32);
 }
 
-int FiveCardLookup(vector<int> cards)
+// Partial Fisher-Yates: shuffles just the cards that get dealt into the front
+// of the deck, remembering the swaps so undealCards can restore the deck
+template <class Rng>
+inline void dealCards(int *deck, int *swaps, Rng &rng, int first = 0)
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  return HR[p];
+  for (int j = first; j < DEALT_CARDS; j++)
+  {
+    int k = j + boundedRandom(rng, 52 - j);
+    swaps[j] = k;
+    std::swap(deck[j], deck[k]);
+  }
 }
 
-int SixCardLookup(vector<int> cards)
+inline void undealCards(int *deck, const int *swaps)
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  p = HR[p + cards[5]];
-  return HR[p];
+  for (int j = DEALT_CARDS - 1; j >= 0; j--)
+  {
+    std::swap(deck[j], deck[swaps[j]]);
+  }
 }
 
-__forceinline int SixCardLookupFast(const int* cards)
+// Deals with the first two cards fixed, from a deck in its base order: they
+// are swapped to the front and the other 7 are shuffled in behind them
+template <class Rng>
+inline void dealCardsWith(int *deck, int *swaps, Rng &rng, int card0, int card1)
 {
-  int p = HR[53 + cards[0]];
-  p = HR[p + cards[1]];
-  p = HR[p + cards[2]];
-  p = HR[p + cards[3]];
-  p = HR[p + cards[4]];
-  p = HR[p + cards[5]];
-  return HR[p];
+  swaps[0] = card0 - 1;
+  std::swap(deck[0], deck[swaps[0]]);
+  swaps[1] = card1 == 1 ? swaps[0] : card1 - 1;
+  std::swap(deck[1], deck[swaps[1]]);
+  dealCards(deck, swaps, rng, 2);
 }
 
-double getBlindBetPayTable(int handRank)
+// Where each card of a hand (community, player, dealer order) sits in a deck
+// dealt by dealCardsWith, which puts the player's cards first
+const int FIXED_PLAYER_LAYOUT[DEALT_CARDS] = {2, 3, 4, 5, 6, 0, 1, 7, 8};
+const int DEALT_LAYOUT[DEALT_CARDS] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+// The same deal with the player's and dealer's hole cards exchanged
+const int EXCHANGED_LAYOUT[DEALT_CARDS] = {0, 1, 2, 3, 4, 7, 8, 5, 6};
+
+// The 1326 two-card combos for stratified sampling, in a fixed scrambled
+// order so any run of consecutive hands spreads over every kind of hand.
+// Classes number the 169 kinds of hole cards: pairs and suited hands above
+// the diagonal of a 13x13 rank grid, offsuit hands below it.
+const int HOLE_CARD_COMBOS = 1326;
+const int HOLE_CARD_CLASSES = 169;
+
+struct holeCardStrata
 {
-  double multiplier = 0;
-  int handType = handRank >> 12;
-  switch (handType)
+  int cards[HOLE_CARD_COMBOS][2];
+  int classes[HOLE_CARD_COMBOS];
+  int classCombos[HOLE_CARD_CLASSES]; // 6 for pairs, 4 suited, 12 offsuit
+};
+
+holeCardStrata buildHoleCardStrata()
+{
+  holeCardStrata strata{};
+  int combo = 0;
+  for (int card0 = 1; card0 <= 52; card0++)
   {
-  case 5:
-    multiplier = 1;
-    break;
-  case 6:
-    multiplier = 1.5;
-    break;
-  case 7:
-    multiplier = 3;
-    break;
-  case 8:
-    multiplier = 10;
-    break;
-  case 9:
-    if (handRank == ROYAL_FLUSH)
-    {
-      multiplier = 500;
-    }
-    else
+    for (int card1 = card0 + 1; card1 <= 52; card1++)
     {
-      multiplier = 50;
+      strata.cards[combo][0] = card0;
+      strata.cards[combo][1] = card1;
+      combo++;
     }
-    break;
   }
-  return multiplier;
+  for (int i = HOLE_CARD_COMBOS - 1; i > 0; i--)
+  {
+    int j = (int)(mix64(i) % (uint64_t)(i + 1));
+    std::swap(strata.cards[i], strata.cards[j]);
+  }
+  for (int i = 0; i < HOLE_CARD_COMBOS; i++)
+  {
+    int high = (strata.cards[i][1] - 1) / 4;
+    int low = (strata.cards[i][0] - 1) / 4;
+    bool suited = (strata.cards[i][1] - strata.cards[i][0]) % 4 == 0;
+    strata.classes[i] = suited || high == low ? high * 13 + low : low * 13 + high;
+    strata.classCombos[strata.classes[i]]++;
+  }
+  return strata;
 }
 
-bool isUnique(vector<int> &x)
+const holeCardStrata HOLE_CARD_STRATA = buildHoleCardStrata();
+
+// FNV-1a over the whole table, compared against HANDRANKS_CHECKSUM when set
+uint64_t handRanksChecksum(const int *table, int64_t entries)
 {
-  sort(x.begin(), x.end());
-  return adjacent_find(x.begin(), x.end()) == x.end();
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(table);
+  uint64_t hash = 14695981039346656037ULL;
+  for (int64_t i = 0; i < entries * (int64_t)sizeof(int); i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
 }
 
-template <class T, class Func>
-auto Map(const std::vector<T> &input_array, Func op)
+// HandRanks.dat has no header, so check a few hands whose ranks are fixed by
+// the 2+2 format. A truncated or corrupt download fails these long before
+// it would silently skew a simulation.
+bool validateHandRanks(const int *table)
 {
-  std::vector<int> result_array;
-  std::transform(input_array.begin(), input_array.end(), std::back_inserter(result_array), op);
-  return result_array;
+  auto lookup = [table](std::initializer_list<int> cards)
+  {
+    int p = 53;
+    for (int card : cards)
+      p = table[p + card];
+    return cards.size() == 7 ? p : table[p];
+  };
+  // As Ks Qs Js Ts 2c 3d, in either order
+  if (lookup({52, 48, 44, 40, 36, 1, 6}) != ROYAL_FLUSH || lookup({6, 1, 36, 40, 44, 48, 52}) != ROYAL_FLUSH)
+    return false;
+  // 7c 5d 4h 3s 2c: the worst five card hand
+  if (lookup({21, 14, 11, 8, 1}) != (1 << 12) + 1)
+    return false;
+  // Ac Ad Ah As Kc Qd Jh: aces full can't happen, best is quads with a king
+  if (lookup({49, 50, 51, 52, 45, 42, 39}) >> 12 != 8)
+    return false;
+  // 2c 2d 3h 3s 4c 4d: two pair from six cards
+  if (lookup({1, 2, 7, 8, 9, 10}) >> 12 != 3)
+    return false;
+  return true;
 }
 
-int getBadOuts(vector<int> hand, vector<int> communityCards, int maxOuts)
+#ifndef _WIN32
+// Private copy of the table in huge pages. Fewer TLB misses on the random
+// lookup chains, at the cost of the page-cache sharing the mapping gives.
+int *readHandRanksHugePages(int fd, size_t bytes)
 {
-  // Optimized version with reduced allocations and better card checking
-  int handSize = hand.size();
-  int communitySize = communityCards.size();
-  int currentHandSize = handSize + communitySize;
-  
-  // Pre-allocate currentHand and dealerHand to avoid repeated allocations
-  vector<int> currentHand(currentHandSize);
-  vector<int> dealerHand(communitySize + 1);
-  
-  // Build currentHand once
-  for (int i = 0; i < handSize; i++) currentHand[i] = hand[i];
-  for (int i = 0; i < communitySize; i++) currentHand[handSize + i] = communityCards[i];
-  
-  // Build dealerHand base once
-  for (int i = 0; i < communitySize; i++) dealerHand[i] = communityCards[i];
-  
-  // Optimized card existence checking with boolean array
-  bool cardExists[53] = {false};
-  for (int i = 0; i < currentHandSize; i++) {
-    cardExists[currentHand[i]] = true;
+  const size_t hugePageSize = 2 * 1024 * 1024;
+  size_t mapBytes = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+  void *mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  mem = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (mem == MAP_FAILED)
+  {
+    // No reserved hugetlbfs pages, fall back to transparent huge pages
+    mem = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+      return nullptr;
+#ifdef MADV_HUGEPAGE
+    madvise(mem, mapBytes, MADV_HUGEPAGE);
+#endif
   }
-  
-  int dealerOuts = 0;
-  int currentHandRank = LookupHandFast(currentHand.data());
-  
-  for (int i = 1; i <= 52; i++)
+  size_t done = 0;
+  while (done < bytes)
   {
-    if (!cardExists[i])
+    ssize_t n = pread(fd, (char *)mem + done, bytes - done, done);
+    if (n <= 0)
     {
-      dealerHand[communitySize] = i;
-      if (SixCardLookup(dealerHand) > currentHandRank)
-      {
-        dealerOuts++;
-        if (dealerOuts >= maxOuts)
-        {
-          break;
-        }
-      }
+      munmap(mem, mapBytes);
+      return nullptr;
     }
+    done += n;
   }
-  return dealerOuts;
+  mprotect(mem, mapBytes, PROT_READ);
+  return (int *)mem;
 }
+#endif
 
-int getBadOutsFlop(vector<int> hand, vector<int> flop, vector<int> knownDealerCards, int maxOuts)
+#ifndef _WIN32
+// CPUs or nodes in the kernel's list format, such as "0-15,32-47"
+vector<int> readSystemList(const string &path)
 {
-  // Optimized version with reduced allocations and better card checking
-  int handSize = hand.size();
-  int flopSize = flop.size();
-  int knownDealerSize = knownDealerCards.size();
-  int currentHandSize = handSize + flopSize;
-  
-  // Pre-allocate to avoid repeated allocations
-  vector<int> currentHand(currentHandSize + 1); // +1 for potential extension
-  vector<int> dealerHand(flopSize + knownDealerSize + 1);
-  
-  // Build currentHand once
-  for (int i = 0; i < handSize; i++) currentHand[i] = hand[i];
-  for (int i = 0; i < flopSize; i++) currentHand[handSize + i] = flop[i];
-  
-  // Build dealerHand base once
-  for (int i = 0; i < flopSize; i++) dealerHand[i] = flop[i];
-  for (int i = 0; i < knownDealerSize; i++) dealerHand[flopSize + i] = knownDealerCards[i];
-  
-  // Optimized card existence checking with boolean array
-  bool cardExists[53] = {false};
-  for (int i = 0; i < currentHandSize; i++) {
-    cardExists[currentHand[i]] = true;
-  }
-  for (int i = 0; i < knownDealerSize; i++) {
-    cardExists[knownDealerCards[i]] = true;
-  }
-  
-  int dealerOuts = 0;
-  int currentHandRank = FiveCardLookupFast(currentHand.data());
-  
-  for (int i = 1; i <= 52; i++)
+  vector<int> items;
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+    return items;
+  char line[4096];
+  if (fgets(line, sizeof(line), file))
   {
-    if (!cardExists[i])
+    for (char *range = strtok(line, ",\n"); range; range = strtok(nullptr, ",\n"))
     {
-      dealerHand[flopSize + knownDealerSize] = i;
-      int dealerHandSize = flopSize + knownDealerSize + 1;
-      
-      if (dealerHandSize == 6)
-      {
-        currentHand[currentHandSize] = i;
-        int currentHandRank6 = LookupHandFast(currentHand.data());
-        if (SixCardLookup(dealerHand) > currentHandRank6)
-        {
-          dealerOuts++;
-          if (dealerOuts >= maxOuts) break;
-        }
-      }
-      else if (FiveCardLookupFast(dealerHand.data()) > currentHandRank)
-      {
-        dealerOuts++;
-        if (dealerOuts >= maxOuts) break;
-      }
+      int first = 0, last = 0;
+      int fields = sscanf(range, "%d-%d", &first, &last);
+      if (fields == 1)
+        last = first;
+      for (int item = first; fields >= 1 && item <= last; item++)
+        items.push_back(item);
     }
   }
-  return dealerOuts;
+  fclose(file);
+  return items;
 }
 
-int getGoodOuts(vector<int> hand, vector<int> communityCards, int knownDealerCard, int maxOuts, bool push = false)
+bool pinThread(const vector<int> &cpus)
 {
-  // Optimized version with reduced allocations and better card checking
-  int handSize = hand.size();
-  int communitySize = communityCards.size();
-  int currentHandSize = handSize + communitySize;
-  
-  // Pre-allocate to avoid repeated allocations
-  vector<int> currentHand(currentHandSize);
-  vector<int> dealerHand(communitySize + 2); // +2 for knownDealerCard and candidate card
-  
-  // Build currentHand once
-  for (int i = 0; i < handSize; i++) currentHand[i] = hand[i];
-  for (int i = 0; i < communitySize; i++) currentHand[handSize + i] = communityCards[i];
-  
-  // Build dealerHand base once
-  for (int i = 0; i < communitySize; i++) dealerHand[i] = communityCards[i];
-  dealerHand[communitySize] = knownDealerCard;
-  
-  // Optimized card existence checking with boolean array
-  bool cardExists[53] = {false};
-  for (int i = 0; i < currentHandSize; i++) {
-    cardExists[currentHand[i]] = true;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+  {
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
   }
-  cardExists[knownDealerCard] = true;
-  
-  int goodOuts = 0;
-  int currentHandRank = LookupHandFast(currentHand.data());
-  
-  for (int i = 1; i <= 52; i++)
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Copies table into each node's memory: the copy is written from a thread
+// pinned to the node, and the kernel puts pages on the node that first
+// touches them. Leaves HR_numa empty on single-node hosts or if a copy
+// can't be made.
+void loadNumaReplicas(const int *table, size_t bytes)
+{
+  vector<int> nodes = readSystemList("/sys/devices/system/node/online");
+  cpu_set_t original;
+  if (nodes.size() < 2 || sched_getaffinity(0, sizeof(original), &original) != 0)
+    return;
+  numaReplicas replicas;
+  const size_t hugePageSize = 2 * 1024 * 1024;
+  size_t mapBytes = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+  for (int node : nodes)
   {
-    if (!cardExists[i])
-    {
-      dealerHand[communitySize + 1] = i;
-      int dealerHandRank = LookupHandFast(dealerHand.data());
-      
-      if (currentHandRank > dealerHandRank)
-      {
-        goodOuts++;
-      }
-      else if (push && currentHandRank == dealerHandRank)
-      {
-        goodOuts++;
-      }
-      if (goodOuts >= maxOuts)
-      {
-        break;
-      }
-    }
+    // Memory-only nodes have no threads to serve
+    vector<int> cpus = readSystemList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (cpus.empty() || replicas.nodes == MAX_NUMA_NODES || !pinThread(cpus))
+      continue;
+    void *mem = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+      break;
+#ifdef MADV_HUGEPAGE
+    madvise(mem, mapBytes, MADV_HUGEPAGE);
+#endif
+    memcpy(mem, table, bytes);
+    mprotect(mem, mapBytes, PROT_READ);
+    replicas.ids[replicas.nodes] = node;
+    replicas.tables[replicas.nodes] = (const int *)mem;
+    replicas.cpus.push_back(cpus);
+    replicas.nodes++;
   }
-  return goodOuts;
+  sched_setaffinity(0, sizeof(original), &original);
+  if (replicas.nodes < 2)
+  {
+    for (int i = 0; i < replicas.nodes; i++) munmap((void *)replicas.tables[i], mapBytes);
+    return;
+  }
+  HR_numa = replicas;
 }
+#endif
 
-int getPlayBet(vector<int> playerHand, vector<int> communityCards, vector<int> dealerCards, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays)
+// Map the HR table once and cache it. HANDRANKS_PATH overrides the file
+// location, HANDRANKS_HUGEPAGES=1 trades sharing for a huge page copy,
+// HANDRANKS_NUMA=1 adds a copy per NUMA node and HANDRANKS_CHECKSUM holds
+// the expected FNV-1a of the file in hex.
+bool loadHandRanks()
 {
-  int playBet = 0;
-  vector<int> flop;
-  flop.insert(flop.end(), communityCards.begin(), communityCards.end() - 2);
-  vector<int> postFlopHand;
-  postFlopHand.insert(postFlopHand.end(), playerHand.begin(), playerHand.end());
-  postFlopHand.insert(postFlopHand.end(), flop.begin(), flop.end());
-  vector<int> postRiverHand;
-  postRiverHand.insert(postRiverHand.end(), playerHand.begin(), playerHand.end());
-  postRiverHand.insert(postRiverHand.end(), communityCards.begin(), communityCards.end());
-  vector<int> playerCardValues = Map(playerHand, [](int value)
-                                     { return (value - 1) / 4; });
-  vector<int> playerSuitValues = Map(playerHand, [](int value)
-                                     { return value % 4; });
-  vector<int> flopSuitValues = Map(flop, [](int value)
-                                   { return value % 4; });
-  vector<int> flopCardValues = Map(flop, [](int value)
-                                   { return (value - 1) / 4; });
-  vector<int> communityCardValues = Map(communityCards, [](int value)
-                                        { return (value - 1) / 4; });
-  vector<int> dealerCardValues = Map(dealerCards, [](int value)
-                                     { return (value - 1) / 4; });
-  vector<int> sortedSuitValues;
-  sortedSuitValues.insert(sortedSuitValues.end(), playerSuitValues.begin(), playerSuitValues.end());
-  sortedSuitValues.insert(sortedSuitValues.end(), flopSuitValues.begin(), flopSuitValues.end());
-  sort(sortedSuitValues.begin(), sortedSuitValues.end());
-  // Basic Strategy
-  if (knownDealerCards == 0 && knownFlopCards == 0 && knownTurnRiverCards == 0)
+  if (HR_loaded.load(std::memory_order_acquire))
+    return true;
+  std::lock_guard<std::mutex> lock(HR_mutex);
+  if (HR_loaded.load(std::memory_order_relaxed))
+    return true;
+
+  auto start = std::chrono::steady_clock::now();
+  const char *path = getenv("HANDRANKS_PATH") ? getenv("HANDRANKS_PATH") : "HandRanks.dat";
+  const char *hugePagesEnv = getenv("HANDRANKS_HUGEPAGES");
+  bool wantHugePages = hugePagesEnv && strcmp(hugePagesEnv, "1") == 0;
+  const int64_t expectedBytes = HR_ENTRIES * (int64_t)sizeof(int);
+  const int *table = nullptr;
+  bool mapped = false;
+  bool hugePages = false;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (file == INVALID_HANDLE_VALUE)
   {
-    // Preflop
-    if (
-        // Ax
-        playerCardValues[0] >= 12 || playerCardValues[1] >= 12 ||
-        // K2s+, K5+
-        (playerCardValues[0] >= 11 && (playerCardValues[1] >= 3 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
-        (playerCardValues[1] >= 11 && (playerCardValues[0] >= 3 || (playerHand[1] - playerHand[0]) % 4 == 0)) ||
-        // Q6s+, Q8+
-        (playerCardValues[0] >= 10 && (playerCardValues[1] >= 6 || (playerCardValues[1] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0))) ||
-        (playerCardValues[1] >= 10 && (playerCardValues[0] >= 6 || (playerCardValues[0] >= 4 && (playerHand[1] - playerHand[0]) % 4 == 0))) ||
-        // J8s+, JT+
-        (playerCardValues[0] >= 9 && (playerCardValues[1] >= 8 || (playerCardValues[1] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0))) ||
-        (playerCardValues[1] >= 9 && (playerCardValues[0] >= 8 || (playerCardValues[0] >= 6 && (playerHand[1] - playerHand[0]) % 4 == 0))) ||
-        // 33+
-        (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 1))
-    {
-      playBet = 4;
-    }
-    // Postflop
-    else if (
-        // Two pair or better
-        (FiveCardLookupFast(postFlopHand.data()) >> 12 >= 3 &&
-         // Not 3 of a kind with all 3 same flop card
-         !(FiveCardLookupFast(postFlopHand.data()) >> 12 == 4 && flopCardValues[0] == flopCardValues[1] && flopCardValues[0] == flopCardValues[2])) ||
-        // Hidden pair except pocket deuces
-        (FiveCardLookupFast(postFlopHand.data()) >> 12 == 2 && !(playerCardValues[0] == 0 && playerCardValues[1] == 0) && isUnique(flopCardValues)) ||
-        // Four to a flush including a hidden 10 or better
-        ((sortedSuitValues[1] == sortedSuitValues[4] || sortedSuitValues[0] == sortedSuitValues[3]) &&
-         ((sortedSuitValues[2] == playerSuitValues[0] && playerCardValues[0] >= 8) || (sortedSuitValues[2] == playerSuitValues[1] && playerCardValues[1] >= 8))))
+    HR_info.error = "HandRanks.dat not found";
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart != expectedBytes)
+  {
+    CloseHandle(file);
+    HR_info.error = "HandRanks.dat has an unexpected size";
+    return false;
+  }
+  if (wantHugePages)
+  {
+    // Needs SeLockMemoryPrivilege, otherwise we quietly keep the mapping
+    SIZE_T largePage = GetLargePageMinimum();
+    if (largePage > 0)
     {
-      playBet = 2;
-    }
-    // Post-river
-    else {
-      // Early termination: check high-priority conditions first
-      int postRiverRank = LookupHandFast(postRiverHand.data());
-      int postRiverCategory = postRiverRank >> 12;
-      int communityCategory = FiveCardLookupFast(communityCards.data()) >> 12;
-      
-      if (
-          // Two pair or better
-          (postRiverCategory >= 3 &&
-           // Not two pair with two pair on the board
-           !(postRiverCategory == 3 && communityCategory == 3) &&
-           // Not three of a kind with three of a kind on the board
-           !(postRiverCategory == 4 && communityCategory == 4)) ||
-          // Hidden pair
-          (postRiverCategory == 2 && isUnique(communityCardValues)) ||
-          // Less than 21 dealer outs (most expensive check - do last)
-          getBadOuts(playerHand, communityCards, 21) < 21)
+      SIZE_T allocBytes = (expectedBytes + largePage - 1) / largePage * largePage;
+      char *mem = (char *)VirtualAlloc(NULL, allocBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+      if (mem)
       {
-        playBet = 1;
+        int64_t done = 0;
+        while (done < expectedBytes)
+        {
+          DWORD chunk = (DWORD)std::min<int64_t>(expectedBytes - done, 1 << 30);
+          unsigned long n = 0;
+          if (!ReadFile(file, mem + done, chunk, &n, NULL) || n == 0)
+            break;
+          done += n;
+        }
+        if (done == expectedBytes)
+        {
+          table = (const int *)mem;
+          hugePages = true;
+        }
+        else
+        {
+          VirtualFree(mem, 0, MEM_RELEASE);
+        }
       }
     }
   }
-  // 1 known flop card and 1 known dealer card
-  else if (knownDealerCards == 1 && knownFlopCards == 1 && knownTurnRiverCards == 0)
+  if (!table)
   {
-    // Preflop
-    bool allow4xBet = true;
-    if (excludeFishyPlays) {
-      if (playerCardValues[0] != playerCardValues[1]) {
-        int maxCard = (playerCardValues[0] > playerCardValues[1]) ? playerCardValues[0] : playerCardValues[1];
-        // Ten high or lower means max card is 8 or less (Ten=8 in internal representation, so values 0-8 are 2-through-Ten)
-        if (maxCard <= 8) {
-          allow4xBet = false; // Don't allow 4x bet for fishy play
-        }
-      }
-      // If it's a pocket pair or higher than Ten high, allow 4x bet
-    }
-    
-    if (allow4xBet && (
-        // Flop card gives you three of a kind
-        (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] == flopCardValues[0]) ||
-        // Pair of dealer cards or better
-        (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= dealerCardValues[0]) ||
-        // Any pair with flop card, better than dealer card
-        (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] > dealerCardValues[0]) || (playerCardValues[1] == flopCardValues[0] && playerCardValues[1] > dealerCardValues[0]) ||
-        // Any pair with flop card, same as dealer card, with T+ kicker
-        (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] == dealerCardValues[0] && playerCardValues[1] >= 8) ||
-        (playerCardValues[1] == flopCardValues[0] && playerCardValues[1] == dealerCardValues[0] && playerCardValues[0] >= 8) ||
-        // If dealer doesn't have a pair
-        (dealerCardValues[0] != flopCardValues[0] &&
-         // Dealer card or better and ten or better
-         ((playerCardValues[0] >= dealerCardValues[0] && playerCardValues[1] >= 8) || (playerCardValues[1] >= dealerCardValues[0] && playerCardValues[0] >= 8) ||
-          // Pair of 7s or better
-          (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 5) ||
-          (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] >= 5) ||
-          (playerCardValues[1] == flopCardValues[0] && playerCardValues[1]) ||
-          // Q8s+ if dealer card worse than Q
-          (playerCardValues[0] == 10 && dealerCardValues[0] < playerCardValues[0] && playerCardValues[1] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
-          (playerCardValues[1] == 10 && dealerCardValues[0] < playerCardValues[1] && playerCardValues[0] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
-          // K6s+ if dealer card worse than K
-          (playerCardValues[0] == 11 && dealerCardValues[0] < playerCardValues[0] && playerCardValues[1] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
-          (playerCardValues[1] == 11 && dealerCardValues[0] < playerCardValues[1] && playerCardValues[0] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
-          // A2s+, A7o+ if dealer card worse than A
-          (playerCardValues[0] == 12 && dealerCardValues[0] < playerCardValues[0] && (playerCardValues[1] >= 5 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
-          (playerCardValues[1] == 12 && dealerCardValues[0] < playerCardValues[1] && (playerCardValues[0] >= 5 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
-          // H9s+ if dealer card is H = A, K, Q
-          (playerCardValues[0] >= 10 && dealerCardValues[0] == playerCardValues[0] && playerCardValues[1] >= 7 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
-          (playerCardValues[1] >= 10 && dealerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 7 && (playerHand[0] - playerHand[1]) % 4 == 0)))))
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
     {
-      playBet = 4;
+      table = (const int *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      // The view keeps the mapping alive
+      CloseHandle(mapping);
+      mapped = table != nullptr;
     }
-    // Postflop
-    else if (
-        // Less than 12 bad outs and we are ahead
-        getBadOutsFlop(playerHand, flop, {dealerCards.begin(), dealerCards.begin() + 1}, 12) < 12)
-    {
+  }
+  CloseHandle(file);
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    HR_info.error = "HandRanks.dat not found";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (int64_t)st.st_size != expectedBytes)
+  {
+    close(fd);
+    HR_info.error = "HandRanks.dat has an unexpected size";
+    return false;
+  }
+  if (wantHugePages)
+  {
+    table = readHandRanksHugePages(fd, expectedBytes);
+    hugePages = table != nullptr;
+  }
+  if (!table)
+  {
+    void *mem = mmap(nullptr, expectedBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (mem != MAP_FAILED)
+    {
+      // Start paging the table in now rather than on the first simulation
+      madvise(mem, expectedBytes, MADV_WILLNEED);
+      table = (const int *)mem;
+      mapped = true;
+    }
+  }
+  close(fd);
+#endif
+  if (!table)
+  {
+    HR_info.error = "HandRanks.dat could not be mapped";
+    return false;
+  }
+
+  const char *checksumEnv = getenv("HANDRANKS_CHECKSUM");
+  if (!validateHandRanks(table) ||
+      (checksumEnv && handRanksChecksum(table, HR_ENTRIES) != strtoull(checksumEnv, nullptr, 16)))
+  {
+    // Free it, since every status poll tries the load again
+#ifdef _WIN32
+    if (hugePages)
+      VirtualFree((void *)table, 0, MEM_RELEASE);
+    else
+      UnmapViewOfFile(table);
+#else
+    const int64_t hugePageSize = 2 * 1024 * 1024;
+    munmap((void *)table, hugePages ? (expectedBytes + hugePageSize - 1) / hugePageSize * hugePageSize : expectedBytes);
+#endif
+    HR_info.error = "HandRanks.dat failed validation";
+    return false;
+  }
+
+  HR = table;
+#ifndef _WIN32
+  const char *numaEnv = getenv("HANDRANKS_NUMA");
+  if (numaEnv && strcmp(numaEnv, "1") == 0)
+    loadNumaReplicas(table, expectedBytes);
+#endif
+  HR_info.numaNodes = HR_numa.nodes;
+  HR_info.mapped = mapped;
+  HR_info.hugePages = hugePages;
+  HR_info.bytes = expectedBytes;
+  HR_info.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  HR_info.error = "";
+  HR_loaded.store(true, std::memory_order_release);
+  return true;
+}
+
+// A copy of HR_info, which a load on another thread may be writing
+handRanksInfo getHandRanksInfo()
+{
+  std::lock_guard<std::mutex> lock(HR_mutex);
+  return HR_info;
+}
+
+thread_local int threadNumaNode = -1;
+
+// Pins a pool thread to a node, taking the nodes in turn by thread number,
+// and points its lookups at that node's replica. Returns the node's index in
+// HR_numa, or -1 without replicas.
+int useNumaNode(int thread)
+{
+  if (HR_numa.nodes == 0)
+    return -1;
+  int node = thread % HR_numa.nodes;
+  if (threadNumaNode != node)
+  {
+#ifndef _WIN32
+    pinThread(HR_numa.cpus[node]);
+#endif
+    threadHandRanks = &HR_numa.tables[node];
+    threadNumaNode = node;
+  }
+  return node;
+}
+
+void print(std::vector<int> const &input)
+{
+  std::copy(input.begin(),
+            input.end(),
+            std::ostream_iterator<int>(std::cout, " "));
+}
+
+void printError(std::vector<int> const &input)
+{
+  std::copy(input.begin(),
+            input.end(),
+            std::ostream_iterator<int>(std::cerr, " "));
+}
+
+// This function isn't currently used, but shows how you lookup
+// a 7-card poker hand. pCards should be a pointer to an array
+// of 7 integers each with value between 1 and 52 inclusive.
+int LookupHand(vector<int> cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  p = table[p + cards[5]];
+  return table[p + cards[6]];
+}
+
+// Optimized version using raw array pointer for better performance
+FORCE_INLINE int LookupHandFast(const int* cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  p = table[p + cards[5]];
+  return table[p + cards[6]];
+}
+
+
+
+FORCE_INLINE int FiveCardLookupFast(const int* cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  return table[p];
+}
+
+// Hints that the table entry is about to be read
+FORCE_INLINE void prefetchHandRank(const int *entry)
+{
+#ifdef _MSC_VER
+  _mm_prefetch((const char *)entry, _MM_HINT_T0);
+#else
+  __builtin_prefetch(entry);
+#endif
+}
+
+// Structure-of-arrays buffers for a batch of dealt hands. Card k of hand i is
+// card(k)[i], with k in deck order: 5 community, 2 player and 2 dealer cards.
+struct handBatch
+{
+  int capacity;
+  int size;
+  vector<int> cards;
+  vector<int> playBets;
+  vector<int> boardNodes;
+  vector<int> playerRanks;
+  vector<int> dealerRanks;
+
+  handBatch(int capacity) : capacity(capacity), size(0), cards(DEALT_CARDS * capacity), playBets(capacity),
+                            boardNodes(capacity), playerRanks(capacity), dealerRanks(capacity) {}
+
+  int *card(int k) { return cards.data() + k * capacity; }
+};
+
+int FiveCardLookup(vector<int> cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  return table[p];
+}
+
+int SixCardLookup(vector<int> cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  p = table[p + cards[5]];
+  return table[p];
+}
+
+FORCE_INLINE int SixCardLookupFast(const int* cards)
+{
+  const int *table = getHandRanks();
+  int p = table[53 + cards[0]];
+  p = table[p + cards[1]];
+  p = table[p + cards[2]];
+  p = table[p + cards[3]];
+  p = table[p + cards[4]];
+  p = table[p + cards[5]];
+  return table[p];
+}
+
+// Incremental position in the HandRanks chain. extend() adds one card to
+// the hand, and since the table doesn't depend on card order a shared prefix
+// such as the board can be walked once and then forked into several hands
+// by extending copies of the same state.
+struct handState
+{
+  int node;
+  int size;
+
+  handState() : node(53), size(0) {}
+  handState(int node, int size) : node(node), size(size) {}
+
+  handState extend(int card) const
+  {
+    PROFILE_COUNT(PROFILE_HAND_RANK_LOOKUPS);
+    return handState(getHandRanks()[node + card], size + 1);
+  }
+
+  handState extend(int card0, int card1) const
+  {
+    return extend(card0).extend(card1);
+  }
+
+  handState extend(const int *cards, int count) const
+  {
+    handState state = *this;
+    for (int i = 0; i < count; i++)
+    {
+      state = state.extend(cards[i]);
+    }
+    return state;
+  }
+
+  // Rank of the hand so far, for 5 to 7 cards. After the 7th card the
+  // table returns the rank itself rather than another node.
+  int rank() const
+  {
+    PROFILE_ADD(PROFILE_HAND_RANK_LOOKUPS, size < 7);
+    return size == 7 ? node : getHandRanks()[node];
+  }
+};
+
+inline int countBits(uint32_t bits)
+{
+#ifdef _MSC_VER
+  return (int)__popcnt(bits);
+#else
+  return __builtin_popcount(bits);
+#endif
+}
+
+// Index of the highest set bit; bits must not be 0
+inline int highestBit(uint32_t bits)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse(&index, bits);
+  return (int)index;
+#else
+  return 31 - __builtin_clz(bits);
+#endif
+}
+
+// Keeps the count highest set bits
+inline uint32_t highestBits(uint32_t bits, int count)
+{
+  uint32_t kept = 0;
+  for (int i = 0; i < count && bits; i++)
+  {
+    uint32_t bit = 1u << highestBit(bits);
+    kept |= bit;
+    bits ^= bit;
+  }
+  return kept;
+}
+
+// Highest card of the best straight in a set of ranks, or -1
+int getStraightHigh(int ranks)
+{
+  for (int high = 12; high >= 4; high--)
+  {
+    if (((ranks >> (high - 4)) & 31) == 31)
+      return high;
+  }
+  // Five high (A2345)
+  if ((ranks & 0x100F) == 0x100F)
+    return 3;
+  return -1;
+}
+
+// The compact evaluator's only table: for every set of 5 or more distinct
+// ranks, the rank of the best straight or high card hand made from it, in
+// the HandRanks numbering (category << 12 | position within the category).
+// 16 KB, so it stays in cache where the 130 MB HandRanks table can't.
+struct compactEvaluatorTables
+{
+  uint16_t distinctRanks[1 << 13];
+};
+
+compactEvaluatorTables buildCompactEvaluatorTables()
+{
+  compactEvaluatorTables tables = {};
+  // High card hands are numbered in increasing order of their 5-rank masks,
+  // which is the order of their strength
+  vector<int> highCardIndex(1 << 13, 0);
+  int highCards = 0;
+  for (int ranks = 0; ranks < (1 << 13); ranks++)
+  {
+    if (countBits(ranks) == 5 && getStraightHigh(ranks) < 0)
+      highCardIndex[ranks] = ++highCards;
+  }
+  for (int ranks = 0; ranks < (1 << 13); ranks++)
+  {
+    if (countBits(ranks) < 5)
+      continue;
+    int straightHigh = getStraightHigh(ranks);
+    if (straightHigh >= 0)
+      tables.distinctRanks[ranks] = (uint16_t)((5 << 12) | (straightHigh - 2));
+    else
+      tables.distinctRanks[ranks] = (uint16_t)((1 << 12) | highCardIndex[highestBits(ranks, 5)]);
+  }
+  return tables;
+}
+
+const compactEvaluatorTables COMPACT_EVALUATOR_TABLES = buildCompactEvaluatorTables();
+
+const int KICKER_BINOMIALS[13][4] = {
+    {1, 0, 0, 0}, {1, 1, 0, 0}, {1, 2, 1, 0}, {1, 3, 3, 1}, {1, 4, 6, 4}, {1, 5, 10, 10}, {1, 6, 15, 20},
+    {1, 7, 21, 35}, {1, 8, 28, 56}, {1, 9, 36, 84}, {1, 10, 45, 120}, {1, 11, 55, 165}, {1, 12, 66, 220}};
+
+// Position of a set of kickers among every set of as many ranks other than
+// the excluded rank, in increasing order of strength (colex order)
+inline int getKickerIndex(uint32_t kickers, int excluded)
+{
+  int index = 0;
+  int chosen = 0;
+  while (kickers)
+  {
+    int rank = highestBit(kickers & (0u - kickers));
+    int position = rank - (excluded < rank);
+    index += KICKER_BINOMIALS[position][++chosen];
+    kickers &= kickers - 1;
+  }
+  return index;
+}
+
+// Cache-resident alternative to handState with the same interface and the
+// same ranks. Instead of a position in the HandRanks table it keeps the
+// ranks held at least once, twice, three and four times, the ranks held in
+// each suit and a byte-wide card count per suit, and works the hand out
+// from those when asked.
+struct compactHandState
+{
+  uint16_t ranks[4];
+  uint16_t suits[4];
+  uint32_t suitCounts;
+  int size;
+
+  compactHandState() : ranks{0, 0, 0, 0}, suits{0, 0, 0, 0}, suitCounts(0), size(0) {}
+
+  compactHandState extend(int card) const
+  {
+    compactHandState state = *this;
+    int suit = (card - 1) & 3;
+    int bit = 1 << ((card - 1) >> 2);
+    state.ranks[3] |= state.ranks[2] & bit;
+    state.ranks[2] |= state.ranks[1] & bit;
+    state.ranks[1] |= state.ranks[0] & bit;
+    state.ranks[0] |= bit;
+    state.suits[suit] |= bit;
+    state.suitCounts += 1u << (suit * 8);
+    state.size++;
+    return state;
+  }
+
+  compactHandState extend(int card0, int card1) const
+  {
+    return extend(card0).extend(card1);
+  }
+
+  compactHandState extend(const int *cards, int count) const
+  {
+    compactHandState state = *this;
+    for (int i = 0; i < count; i++)
+    {
+      state = state.extend(cards[i]);
+    }
+    return state;
+  }
+
+  // Rank of the best 5-card hand so far, for 5 to 7 cards
+  int rank() const
+  {
+    const uint16_t *distinctRanks = COMPACT_EVALUATOR_TABLES.distinctRanks;
+    // Sets the top bit of the byte of any suit with 5 or more cards
+    uint32_t flushSuits = (suitCounts + 0x7B7B7B7B) & 0x80808080;
+    int flush = flushSuits ? suits[highestBit(flushSuits) >> 3] : 0;
+    // Straight flush
+    if (flush && distinctRanks[flush] >> 12 == 5)
+      return distinctRanks[flush] + (4 << 12);
+    // Four of a kind
+    if (ranks[3])
+    {
+      int quads = highestBit(ranks[3]);
+      int kicker = highestBit(ranks[0] & ~(1 << quads));
+      return (8 << 12) | (quads * 12 + kicker - (kicker > quads) + 1);
+    }
+    // Full house
+    if (ranks[2] && (ranks[1] & (ranks[1] - 1)))
+    {
+      int trips = highestBit(ranks[2]);
+      int pair = highestBit(ranks[1] & ~(1 << trips));
+      return (7 << 12) | (trips * 12 + pair - (pair > trips) + 1);
+    }
+    // Flush
+    if (flush)
+      return distinctRanks[flush] + (5 << 12);
+    // Straight
+    if (distinctRanks[ranks[0]] >> 12 == 5)
+      return distinctRanks[ranks[0]];
+    // Three of a kind
+    if (ranks[2])
+    {
+      int trips = highestBit(ranks[2]);
+      uint32_t kickers = highestBits(ranks[0] & ~(1 << trips), 2);
+      return (4 << 12) | (trips * 66 + getKickerIndex(kickers, trips) + 1);
+    }
+    // Two pair
+    if (ranks[1] & (ranks[1] - 1))
+    {
+      int highPair = highestBit(ranks[1]);
+      int lowPair = highestBit(ranks[1] & ~(1 << highPair));
+      int kicker = highestBit(ranks[0] & ~(1 << highPair) & ~(1 << lowPair));
+      return (3 << 12) | (11 * highPair * (highPair - 1) / 2 + 11 * lowPair + kicker - (kicker > lowPair) - (kicker > highPair) + 1);
+    }
+    // Pair
+    if (ranks[1])
+    {
+      int pair = highestBit(ranks[1]);
+      uint32_t kickers = highestBits(ranks[0] & ~(1 << pair), 3);
+      return (2 << 12) | (pair * 220 + getKickerIndex(kickers, pair) + 1);
+    }
+    return distinctRanks[ranks[0]];
+  }
+};
+
+// Evaluates the player's and dealer's 7-card hands for a whole batch,
+// leaving the ranks in playerRanks and dealerRanks
+template <class State>
+DISPATCHED_KERNEL void evaluateHandBatch(handBatch &batch)
+{
+  for (int i = 0; i < batch.size; i++)
+  {
+    State board;
+    for (int k = 0; k < 5; k++)
+    {
+      board = board.extend(batch.card(k)[i]);
+    }
+    batch.playerRanks[i] = board.extend(batch.card(5)[i], batch.card(6)[i]).rank();
+    batch.dealerRanks[i] = board.extend(batch.card(7)[i], batch.card(8)[i]).rank();
+  }
+}
+
+// With the HandRanks table each lookup chain is a series of dependent cache
+// misses, so rather than walking one hand at a time this advances every
+// hand's chain by one card per pass, prefetching the next pass's entries so
+// that the misses of the whole batch overlap. The community cards are
+// walked once and the chain then forks into the player's and the dealer's
+// hole cards.
+template <>
+DISPATCHED_KERNEL void evaluateHandBatch<handState>(handBatch &batch)
+{
+  int n = batch.size;
+  const int *table = getHandRanks();
+  PROFILE_ADD(PROFILE_HAND_RANK_LOOKUPS, 9 * n);
+  int *board = batch.boardNodes.data();
+  int *player = batch.playerRanks.data();
+  int *dealer = batch.dealerRanks.data();
+
+  const int *first = batch.card(0);
+  const int *second = batch.card(1);
+  for (int i = 0; i < n; i++)
+  {
+    board[i] = table[53 + first[i]];
+    prefetchHandRank(table + board[i] + second[i]);
+  }
+  for (int k = 1; k < 4; k++)
+  {
+    const int *cards = batch.card(k);
+    const int *next = batch.card(k + 1);
+    for (int i = 0; i < n; i++)
+    {
+      board[i] = table[board[i] + cards[i]];
+      prefetchHandRank(table + board[i] + next[i]);
+    }
+  }
+  const int *river = batch.card(4);
+  const int *playerFirst = batch.card(5);
+  const int *playerSecond = batch.card(6);
+  const int *dealerFirst = batch.card(7);
+  const int *dealerSecond = batch.card(8);
+  for (int i = 0; i < n; i++)
+  {
+    board[i] = table[board[i] + river[i]];
+    prefetchHandRank(table + board[i] + playerFirst[i]);
+    prefetchHandRank(table + board[i] + dealerFirst[i]);
+  }
+  for (int i = 0; i < n; i++)
+  {
+    player[i] = table[board[i] + playerFirst[i]];
+    dealer[i] = table[board[i] + dealerFirst[i]];
+    prefetchHandRank(table + player[i] + playerSecond[i]);
+    prefetchHandRank(table + dealer[i] + dealerSecond[i]);
+  }
+  for (int i = 0; i < n; i++)
+  {
+    player[i] = table[player[i] + playerSecond[i]];
+    dealer[i] = table[dealer[i] + dealerSecond[i]];
+  }
+}
+
+double getBlindBetPayTable(int handRank)
+{
+  double multiplier = 0;
+  int handType = handRank >> 12;
+  switch (handType)
+  {
+  case 5:
+    multiplier = 1;
+    break;
+  case 6:
+    multiplier = 1.5;
+    break;
+  case 7:
+    multiplier = 3;
+    break;
+  case 8:
+    multiplier = 10;
+    break;
+  case 9:
+    if (handRank == ROYAL_FLUSH)
+    {
+      multiplier = 500;
+    }
+    else
+    {
+      multiplier = 50;
+    }
+    break;
+  }
+  return multiplier;
+}
+
+template <class T, class Func>
+auto Map(const std::vector<T> &input_array, Func op)
+{
+  std::vector<int> result_array;
+  std::transform(input_array.begin(), input_array.end(), std::back_inserter(result_array), op);
+  return result_array;
+}
+
+// Cards are bit card (1 to 52) of a card mask
+const uint64_t ALL_CARDS = ((1ULL << 53) - 1) & ~1ULL;
+
+inline uint64_t getCardMask(const int *cards, int count)
+{
+  uint64_t mask = 0;
+  for (int i = 0; i < count; i++)
+  {
+    mask |= 1ULL << cards[i];
+  }
+  return mask;
+}
+
+inline int countCards(uint64_t cards)
+{
+#ifdef _MSC_VER
+  return (int)__popcnt64(cards);
+#else
+  return __builtin_popcountll(cards);
+#endif
+}
+
+// Index of the lowest set bit; bits must not be 0
+inline int lowestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, bits);
+  return (int)index;
+#else
+  return __builtin_ctzll(bits);
+#endif
+}
+
+// True if no two of the cards share a rank
+inline bool hasUniqueRanks(const int *cards, int count)
+{
+  int ranks = 0;
+  for (int i = 0; i < count; i++)
+  {
+    int bit = 1 << ((cards[i] - 1) / 4);
+    if (ranks & bit)
+      return false;
+    ranks |= bit;
+  }
+  return true;
+}
+
+// Four to a flush among the hole cards and the flop, with a hole card of
+// that suit ranked 10 or better
+inline bool hasHiddenFourFlush(const int *playerHand, const int *flop)
+{
+  int suitCounts[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 2; i++) suitCounts[playerHand[i] % 4]++;
+  for (int i = 0; i < 3; i++) suitCounts[flop[i] % 4]++;
+  for (int i = 0; i < 2; i++)
+  {
+    if ((playerHand[i] - 1) / 4 >= 8 && suitCounts[playerHand[i] % 4] >= 4)
+      return true;
+  }
+  return false;
+}
+
+// Outs engine. Every outs count compares hands made of a few known cards (the
+// base) plus one more card, and works from the ranks of the base plus each
+// card, made from compact hand states so they never touch the HandRanks
+// table. A hand's rank is the better of the best hand its ranks make
+// ignoring suits and its best flush, and the first only depends on the
+// multiset of its ranks. So the engine keeps the ignoring-suits ranks of
+// every multiset of 4 to 6 ranks plus a card of each rank in a cache, and a
+// base with 4 or more cards of a suit adds the flushes with the distinct
+// ranks table. The outs functions return their counts up to maxOuts, as the
+// loops over every card did by stopping there.
+//
+// Cache entries are filled on first use, by whichever thread gets there. A
+// multiset's ranks never change, so threads filling one entry at once write
+// the same words, and the last word, with its filled bit, is written last
+// with release ordering so a reader that sees the bit sees the ranks.
+const int OUTS_MIN_BASE = 4;
+const int OUTS_MAX_BASE = 6;
+const int OUTS_CACHE_ENTRIES = 1820 + 6188 + 18564; // Multisets of 4, 5 and 6 ranks
+const uint64_t OUTS_ENTRY_FILLED = 1ULL << 63;
+
+struct outsCacheTables
+{
+  // Index added by copies of a rank taken after chosen lower ranks
+  int multisetIndex[13][OUTS_MAX_BASE + 1][5];
+  int firstEntry[OUTS_MAX_BASE + 2]; // Of the bases of each size
+};
+
+outsCacheTables buildOutsCacheTables()
+{
+  outsCacheTables tables = {};
+  int binomials[13 + OUTS_MAX_BASE][OUTS_MAX_BASE + 1] = {};
+  for (int n = 0; n < 13 + OUTS_MAX_BASE; n++)
+  {
+    binomials[n][0] = 1;
+    for (int k = 1; k <= OUTS_MAX_BASE && n > 0; k++)
+      binomials[n][k] = binomials[n - 1][k - 1] + binomials[n - 1][k];
+  }
+  // In the combinatorial number system, ranks r1 <= r2 <= ... <= rk are at
+  // the sum of C(ri + i - 1, i)
+  for (int rank = 0; rank < 13; rank++)
+  {
+    for (int chosen = 0; chosen <= OUTS_MAX_BASE; chosen++)
+    {
+      for (int copies = 1; copies <= 4 && chosen + copies <= OUTS_MAX_BASE; copies++)
+        tables.multisetIndex[rank][chosen][copies] = tables.multisetIndex[rank][chosen][copies - 1] + binomials[rank + chosen + copies - 1][chosen + copies];
+    }
+  }
+  for (int size = OUTS_MIN_BASE; size <= OUTS_MAX_BASE; size++)
+    tables.firstEntry[size + 1] = tables.firstEntry[size] + binomials[12 + size][size];
+  return tables;
+}
+
+const outsCacheTables OUTS_CACHE_TABLES = buildOutsCacheTables();
+
+// 13 ranks of 16 bits, the last in the low bits of the last word with the
+// filled bit
+struct outsCacheEntry
+{
+  atomic<uint64_t> words[4];
+};
+
+outsCacheEntry outsCache[OUTS_CACHE_ENTRIES]; // About 850 KB
+
+struct outsCacheCounts
+{
+  int64_t lookups = 0;
+  int64_t hits = 0;
+
+  void add(const outsCacheCounts &other, int64_t sign = 1)
+  {
+    lookups += sign * other.lookups;
+    hits += sign * other.hits;
+  }
+};
+
+thread_local INITIAL_EXEC_TLS outsCacheCounts threadOutsCache;
+
+inline compactHandState getCompactHandState(uint64_t cards)
+{
+  compactHandState state;
+  for (; cards; cards &= cards - 1)
+    state = state.extend(lowestBit(cards));
+  return state;
+}
+
+// Rank of the flush in a suit's ranks, which must number 5 or more
+inline int getFlushRank(int ranks)
+{
+  int distinctRanks = COMPACT_EVALUATOR_TABLES.distinctRanks[ranks];
+  return distinctRanks >> 12 == 5 ? distinctRanks + (4 << 12) : distinctRanks + (5 << 12);
+}
+
+// Ranks of the base plus one card: of a card of each rank outside the flush
+// draw's suit, and of each card of that suit in flushCards
+struct outsRanks
+{
+  uint16_t plain[13];
+  uint64_t flushCards;
+  uint16_t flush[53]; // By card
+
+  int get(int card) const
+  {
+    return (flushCards >> card & 1) ? flush[card] : plain[(card - 1) >> 2];
+  }
+};
+
+void getOutsRanks(const compactHandState &base, outsRanks &ranks)
+{
+  int index = OUTS_CACHE_TABLES.firstEntry[base.size];
+  int chosen = 0;
+  for (uint32_t held = base.ranks[0]; held; held &= held - 1)
+  {
+    int rank = highestBit(held & (0u - held));
+    int copies = 1 + (base.ranks[1] >> rank & 1) + (base.ranks[2] >> rank & 1) + (base.ranks[3] >> rank & 1);
+    index += OUTS_CACHE_TABLES.multisetIndex[rank][chosen][copies];
+    chosen += copies;
+  }
+  outsCacheEntry &entry = outsCache[index];
+  threadOutsCache.lookups++;
+  uint64_t words[4];
+  words[3] = entry.words[3].load(std::memory_order_acquire);
+  if (words[3] & OUTS_ENTRY_FILLED)
+  {
+    threadOutsCache.hits++;
+    for (int i = 0; i < 3; i++) words[i] = entry.words[i].load(std::memory_order_relaxed);
+  }
+  else
+  {
+    // Without suit counts the state never sees a flush
+    compactHandState ranksOnly = base;
+    ranksOnly.suitCounts = 0;
+    words[0] = words[1] = words[2] = 0;
+    words[3] |= OUTS_ENTRY_FILLED;
+    for (int rank = 0; rank < 13; rank++)
+      words[rank >> 2] |= (uint64_t)ranksOnly.extend(rank * 4 + 1).rank() << ((rank & 3) * 16);
+    for (int i = 0; i < 3; i++) entry.words[i].store(words[i], std::memory_order_relaxed);
+    entry.words[3].store(words[3], std::memory_order_release);
+  }
+  for (int rank = 0; rank < 13; rank++)
+    ranks.plain[rank] = (uint16_t)(words[rank >> 2] >> ((rank & 3) * 16));
+
+  ranks.flushCards = 0;
+  // Sets the top bit of the byte of any suit with 4 or more cards; with at
+  // most 6 cards there can only be one
+  uint32_t flushSuits = (base.suitCounts + 0x7C7C7C7C) & 0x80808080;
+  if (!flushSuits)
+    return;
+  int suit = highestBit(flushSuits) >> 3;
+  int suited = base.suits[suit];
+  if (countBits(suited) >= 5)
+  {
+    uint16_t flushRank = (uint16_t)getFlushRank(suited);
+    for (int rank = 0; rank < 13; rank++) ranks.plain[rank] = max(ranks.plain[rank], flushRank);
+  }
+  for (int rank = 0; rank < 13; rank++)
+  {
+    if (suited >> rank & 1)
+      continue;
+    int card = rank * 4 + suit + 1;
+    ranks.flushCards |= 1ULL << card;
+    ranks.flush[card] = (uint16_t)max<int>(ranks.plain[rank], getFlushRank(suited | 1 << rank));
+  }
+}
+
+// Cards among candidates whose outs rank is counted
+template <class Counted>
+int countOuts(const outsRanks &ranks, uint64_t candidates, Counted counted)
+{
+  uint64_t countedCards = 0;
+  for (int rank = 0; rank < 13; rank++)
+    countedCards |= (0 - (uint64_t)counted(ranks.plain[rank])) & (0xFULL << (rank * 4 + 1));
+  countedCards &= ~ranks.flushCards;
+  for (uint64_t flush = candidates & ranks.flushCards; flush; flush &= flush - 1)
+  {
+    if (counted(ranks.flush[lowestBit(flush)]))
+      countedCards |= flush & (0 - flush);
+  }
+  return countCards(countedCards & candidates);
+}
+
+// Dealer cards that would beat the player's 7-card hand, given the state
+// after the 5 community cards and the cards already dealt
+template <class State>
+int getBadOuts(const int *hand, uint64_t usedCards, const State &board, int maxOuts)
+{
+  PROFILE_COUNT(PROFILE_BAD_OUTS_CALLS);
+  int currentHandRank = board.extend(hand[0], hand[1]).rank();
+  outsRanks dealerRanks;
+  getOutsRanks(getCompactHandState(usedCards & ~getCardMask(hand, 2)), dealerRanks);
+  int dealerOuts = countOuts(dealerRanks, ALL_CARDS & ~usedCards, [&](int rank)
+                             { return rank > currentHandRank; });
+  if (dealerOuts >= maxOuts)
+  {
+    PROFILE_COUNT(PROFILE_BAD_OUTS_EARLY_EXITS);
+    return maxOuts;
+  }
+  return dealerOuts;
+}
+
+// Dealer cards that would put the dealer ahead on the flop, given the state
+// after the flop cards and the cards already dealt
+template <class State>
+int getBadOutsFlop(const int *hand, const int *knownDealerCards, int knownDealerCount, uint64_t usedCards, const State &flopState, int maxOuts)
+{
+  PROFILE_COUNT(PROFILE_BAD_OUTS_CALLS);
+  int dealerOuts = 0;
+  // The table keeps a state's next cards side by side, so walking them from
+  // the 4-card dealer hand beats working out its ranks
+  if (std::is_same<State, handState>::value && knownDealerCount == 1)
+  {
+    int currentHandRank = flopState.extend(hand[0], hand[1]).rank();
+    State dealerHand = flopState.extend(knownDealerCards[0]);
+    for (uint64_t candidates = ALL_CARDS & ~usedCards; candidates; candidates &= candidates - 1)
+    {
+      if (dealerHand.extend(lowestBit(candidates)).rank() > currentHandRank && ++dealerOuts >= maxOuts)
+      {
+        PROFILE_COUNT(PROFILE_BAD_OUTS_EARLY_EXITS);
+        return maxOuts;
+      }
+    }
+    return dealerOuts;
+  }
+
+  uint64_t handCards = getCardMask(hand, 2);
+  uint64_t dealerCards = getCardMask(knownDealerCards, knownDealerCount);
+  outsRanks dealerRanks;
+  getOutsRanks(getCompactHandState(usedCards & ~handCards), dealerRanks);
+  // With two dealer cards both hands take the out as their 6th card
+  if (knownDealerCount == 2)
+  {
+    outsRanks playerRanks;
+    getOutsRanks(getCompactHandState(usedCards & ~dealerCards), playerRanks);
+    for (uint64_t candidates = ALL_CARDS & ~usedCards; candidates; candidates &= candidates - 1)
+    {
+      int card = lowestBit(candidates);
+      dealerOuts += dealerRanks.get(card) > playerRanks.get(card);
+    }
+  }
+  else
+  {
+    int currentHandRank = flopState.extend(hand[0], hand[1]).rank();
+    dealerOuts = countOuts(dealerRanks, ALL_CARDS & ~usedCards, [&](int rank)
+                           { return rank > currentHandRank; });
+  }
+  if (dealerOuts >= maxOuts)
+  {
+    PROFILE_COUNT(PROFILE_BAD_OUTS_EARLY_EXITS);
+    return maxOuts;
+  }
+  return dealerOuts;
+}
+
+// Second dealer cards the player's 7-card hand would beat (or tie, with
+// push), given the state after the 5 community cards and the cards already
+// dealt
+template <class State>
+int getGoodOuts(const int *hand, int knownDealerCard, uint64_t usedCards, const State &board, int maxOuts, bool push = false)
+{
+  PROFILE_COUNT(PROFILE_GOOD_OUTS_CALLS);
+  int currentHandRank = board.extend(hand[0], hand[1]).rank();
+  outsRanks dealerRanks;
+  getOutsRanks(getCompactHandState((usedCards & ~getCardMask(hand, 2)) | 1ULL << knownDealerCard), dealerRanks);
+  int goodOuts = countOuts(dealerRanks, ALL_CARDS & ~usedCards & ~(1ULL << knownDealerCard), [&](int rank)
+                           { return currentHandRank > rank || (push && currentHandRank == rank); });
+  if (goodOuts >= maxOuts)
+  {
+    PROFILE_COUNT(PROFILE_GOOD_OUTS_EARLY_EXITS);
+    return maxOuts;
+  }
+  return goodOuts;
+}
+
+// Fishy plays: unpaired hole cards ten high or lower (Ten is rank 8), or
+// highCard high or lower for a strategy with its own cutoff
+inline bool isFishyHand(const int *playerHand, int highCard = 8)
+{
+  int rank0 = (playerHand[0] - 1) / 4;
+  int rank1 = (playerHand[1] - 1) / 4;
+  return rank0 != rank1 && max(rank0, rank1) <= highCard;
+}
+
+// Reference 4x rules for the default scenario. getPlayBet reads them through
+// the decision tables below; this branchy form is what the tables are
+// compiled from and checked against.
+bool isBasicPreflopRaise(const vector<int> &playerHand)
+{
+  vector<int> playerCardValues = Map(playerHand, [](int value)
+                                     { return (value - 1) / 4; });
+  return (
+    // Ax
+    playerCardValues[0] >= 12 || playerCardValues[1] >= 12 ||
+    // K2s+, K5+
+    (playerCardValues[0] >= 11 && (playerCardValues[1] >= 3 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
+    (playerCardValues[1] >= 11 && (playerCardValues[0] >= 3 || (playerHand[1] - playerHand[0]) % 4 == 0)) ||
+    // Q6s+, Q8+
+    (playerCardValues[0] >= 10 && (playerCardValues[1] >= 6 || (playerCardValues[1] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0))) ||
+    (playerCardValues[1] >= 10 && (playerCardValues[0] >= 6 || (playerCardValues[0] >= 4 && (playerHand[1] - playerHand[0]) % 4 == 0))) ||
+    // J8s+, JT+
+    (playerCardValues[0] >= 9 && (playerCardValues[1] >= 8 || (playerCardValues[1] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0))) ||
+    (playerCardValues[1] >= 9 && (playerCardValues[0] >= 8 || (playerCardValues[0] >= 6 && (playerHand[1] - playerHand[0]) % 4 == 0))) ||
+    // 33+
+    (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 1));
+}
+
+// Reference 4x rules with 1 known flop card and 1 known dealer card
+bool isKnownCardsPreflopRaise(const vector<int> &playerHand, int dealerCard, int flopCard, bool excludeFishyPlays)
+{
+  vector<int> playerCardValues = Map(playerHand, [](int value)
+                                     { return (value - 1) / 4; });
+  vector<int> dealerCardValues = {(dealerCard - 1) / 4};
+  vector<int> flopCardValues = {(flopCard - 1) / 4};
+  bool allow4xBet = !(excludeFishyPlays && isFishyHand(playerHand.data()));
+  return allow4xBet && (
+    // Flop card gives you three of a kind
+    (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] == flopCardValues[0]) ||
+    // Pair of dealer cards or better
+    (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= dealerCardValues[0]) ||
+    // Any pair with flop card, better than dealer card
+    (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] > dealerCardValues[0]) || (playerCardValues[1] == flopCardValues[0] && playerCardValues[1] > dealerCardValues[0]) ||
+    // Any pair with flop card, same as dealer card, with T+ kicker
+    (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] == dealerCardValues[0] && playerCardValues[1] >= 8) ||
+    (playerCardValues[1] == flopCardValues[0] && playerCardValues[1] == dealerCardValues[0] && playerCardValues[0] >= 8) ||
+    // If dealer doesn't have a pair
+    (dealerCardValues[0] != flopCardValues[0] &&
+     // Dealer card or better and ten or better
+     ((playerCardValues[0] >= dealerCardValues[0] && playerCardValues[1] >= 8) || (playerCardValues[1] >= dealerCardValues[0] && playerCardValues[0] >= 8) ||
+      // Pair of 7s or better
+      (playerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 5) ||
+      (playerCardValues[0] == flopCardValues[0] && playerCardValues[0] >= 5) ||
+      (playerCardValues[1] == flopCardValues[0] && playerCardValues[1]) ||
+      // Q8s+ if dealer card worse than Q
+      (playerCardValues[0] == 10 && dealerCardValues[0] < playerCardValues[0] && playerCardValues[1] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
+      (playerCardValues[1] == 10 && dealerCardValues[0] < playerCardValues[1] && playerCardValues[0] >= 6 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
+      // K6s+ if dealer card worse than K
+      (playerCardValues[0] == 11 && dealerCardValues[0] < playerCardValues[0] && playerCardValues[1] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
+      (playerCardValues[1] == 11 && dealerCardValues[0] < playerCardValues[1] && playerCardValues[0] >= 4 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
+      // A2s+, A7o+ if dealer card worse than A
+      (playerCardValues[0] == 12 && dealerCardValues[0] < playerCardValues[0] && (playerCardValues[1] >= 5 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
+      (playerCardValues[1] == 12 && dealerCardValues[0] < playerCardValues[1] && (playerCardValues[0] >= 5 || (playerHand[0] - playerHand[1]) % 4 == 0)) ||
+      // H9s+ if dealer card is H = A, K, Q
+      (playerCardValues[0] >= 10 && dealerCardValues[0] == playerCardValues[0] && playerCardValues[1] >= 7 && (playerHand[0] - playerHand[1]) % 4 == 0) ||
+      (playerCardValues[1] >= 10 && dealerCardValues[0] == playerCardValues[1] && playerCardValues[0] >= 7 && (playerHand[0] - playerHand[1]) % 4 == 0))));
+}
+
+// The 4x decision only depends on the hole card ranks and whether they are
+// suited (plus the dealer and flop upcard ranks with known cards), so it is
+// compiled once into bit tables keyed by that canonical state. Hole cards
+// stay in deal order because the known card rules don't treat them alike.
+const int HOLE_CARDS_KEYS = 13 * 13 * 2;
+const int KNOWN_CARDS_KEYS = HOLE_CARDS_KEYS * 13 * 13;
+
+struct preflopRaiseTables
+{
+  uint64_t basic[(HOLE_CARDS_KEYS + 63) / 64];
+  // Indexed by excludeFishyPlays
+  uint64_t knownCards[2][(KNOWN_CARDS_KEYS + 63) / 64];
+};
+
+inline int getHoleCardsKey(int card0, int card1)
+{
+  return (((card0 - 1) / 4) * 13 + (card1 - 1) / 4) * 2 + ((card0 - card1) % 4 == 0);
+}
+
+inline int getKnownCardsKey(int card0, int card1, int dealerCard, int flopCard)
+{
+  return (getHoleCardsKey(card0, card1) * 13 + (dealerCard - 1) / 4) * 13 + (flopCard - 1) / 4;
+}
+
+inline bool hasPreflopRaise(const uint64_t *table, int key)
+{
+  return (table[key >> 6] >> (key & 63)) & 1;
+}
+
+// A card of the given rank in the first suit none of the other cards use
+int getRepresentativeCard(int rank, const vector<int> &cards)
+{
+  for (int suit = 0; suit < 4; suit++)
+  {
+    int card = rank * 4 + suit + 1;
+    if (find(cards.begin(), cards.end(), card) == cards.end())
+      return card;
+  }
+  return 0;
+}
+
+preflopRaiseTables buildPreflopRaiseTables()
+{
+  preflopRaiseTables tables;
+  memset(&tables, 0, sizeof(tables));
+  for (int rank0 = 0; rank0 < 13; rank0++)
+  {
+    for (int rank1 = 0; rank1 < 13; rank1++)
+    {
+      for (int suited = 0; suited < 2; suited++)
+      {
+        // A suited pair can't be dealt
+        if (rank0 == rank1 && suited)
+          continue;
+        vector<int> playerHand = {rank0 * 4 + 1, rank1 * 4 + (suited ? 1 : 2)};
+        int holeKey = getHoleCardsKey(playerHand[0], playerHand[1]);
+        if (isBasicPreflopRaise(playerHand))
+          tables.basic[holeKey >> 6] |= 1ULL << (holeKey & 63);
+        for (int dealerRank = 0; dealerRank < 13; dealerRank++)
+        {
+          vector<int> cards = playerHand;
+          int dealerCard = getRepresentativeCard(dealerRank, cards);
+          cards.push_back(dealerCard);
+          for (int flopRank = 0; flopRank < 13; flopRank++)
+          {
+            int flopCard = getRepresentativeCard(flopRank, cards);
+            int key = getKnownCardsKey(playerHand[0], playerHand[1], dealerCard, flopCard);
+            for (int excludeFishyPlays = 0; excludeFishyPlays < 2; excludeFishyPlays++)
+            {
+              if (isKnownCardsPreflopRaise(playerHand, dealerCard, flopCard, excludeFishyPlays))
+                tables.knownCards[excludeFishyPlays][key >> 6] |= 1ULL << (key & 63);
+            }
+          }
+        }
+      }
+    }
+  }
+  return tables;
+}
+
+const preflopRaiseTables &getPreflopRaiseTables()
+{
+  static const preflopRaiseTables tables = buildPreflopRaiseTables();
+  return tables;
+}
+
+// Checks the tables against the reference rules for every distinct deal of
+// the cards they depend on. Returns the number of mismatches.
+int64_t verifyPreflopRaiseTables(int64_t &checked)
+{
+  const preflopRaiseTables &tables = getPreflopRaiseTables();
+  int64_t mismatches = 0;
+  checked = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : mismatches, checked)
+  for (int card0 = 1; card0 <= 52; card0++)
+  {
+    for (int card1 = 1; card1 <= 52; card1++)
+    {
+      if (card1 == card0)
+        continue;
+      vector<int> playerHand = {card0, card1};
+      checked++;
+      if (hasPreflopRaise(tables.basic, getHoleCardsKey(card0, card1)) != isBasicPreflopRaise(playerHand))
+        mismatches++;
+      for (int dealerCard = 1; dealerCard <= 52; dealerCard++)
+      {
+        for (int flopCard = 1; flopCard <= 52; flopCard++)
+        {
+          if (dealerCard == card0 || dealerCard == card1 || flopCard == card0 || flopCard == card1 || flopCard == dealerCard)
+            continue;
+          int key = getKnownCardsKey(card0, card1, dealerCard, flopCard);
+          for (int excludeFishyPlays = 0; excludeFishyPlays < 2; excludeFishyPlays++)
+          {
+            checked++;
+            if (hasPreflopRaise(tables.knownCards[excludeFishyPlays], key) != isKnownCardsPreflopRaise(playerHand, dealerCard, flopCard, excludeFishyPlays))
+              mismatches++;
+          }
+        }
+      }
+    }
+  }
+  return mismatches;
+}
+
+// Streets the player decides on. The play bet normally starts from the
+// preflop, but a hand that has already checked can start from a later one.
+enum decisionStreet
+{
+  PREFLOP_STREET,
+  FLOP_STREET,
+  RIVER_STREET
+};
+
+template <class State = handState>
+int getPlayBet(const int *playerHand, const int *communityCards, const int *dealerCards, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays,
+               decisionStreet firstStreet = PREFLOP_STREET)
+{
+  int playBet = 0;
+  const int *flop = communityCards;
+  // The flop and the full board are walked once and forked into each hand
+  State flopState = State().extend(flop, 3);
+  State board = flopState.extend(communityCards[3], communityCards[4]);
+  uint64_t usedCards = getCardMask(playerHand, 2) | getCardMask(communityCards, 5);
+  int playerCardValues[2] = {(playerHand[0] - 1) / 4, (playerHand[1] - 1) / 4};
+  // Basic Strategy
+  if (knownDealerCards == 0 && knownFlopCards == 0 && knownTurnRiverCards == 0)
+  {
+    // Preflop
+    if (firstStreet == PREFLOP_STREET && hasPreflopRaise(getPreflopRaiseTables().basic, getHoleCardsKey(playerHand[0], playerHand[1])))
+    {
+      playBet = 4;
+    }
+    // Postflop
+    else if (
+        firstStreet <= FLOP_STREET &&
+        // Two pair or better
+        ((flopState.extend(playerHand[0], playerHand[1]).rank() >> 12 >= 3 &&
+         // Not 3 of a kind with all 3 same flop card
+         !(flopState.extend(playerHand[0], playerHand[1]).rank() >> 12 == 4 && (flop[0] - 1) / 4 == (flop[1] - 1) / 4 && (flop[0] - 1) / 4 == (flop[2] - 1) / 4)) ||
+        // Hidden pair except pocket deuces
+        (flopState.extend(playerHand[0], playerHand[1]).rank() >> 12 == 2 && !(playerCardValues[0] == 0 && playerCardValues[1] == 0) && hasUniqueRanks(flop, 3)) ||
+        // Four to a flush including a hidden 10 or better
+        hasHiddenFourFlush(playerHand, flop)))
+    {
+      playBet = 2;
+    }
+    // Post-river
+    else {
+      // Early termination: check high-priority conditions first
+      int postRiverRank = board.extend(playerHand[0], playerHand[1]).rank();
+      int postRiverCategory = postRiverRank >> 12;
+      int communityCategory = board.rank() >> 12;
+      
+      if (
+          // Two pair or better
+          (postRiverCategory >= 3 &&
+           // Not two pair with two pair on the board
+           !(postRiverCategory == 3 && communityCategory == 3) &&
+           // Not three of a kind with three of a kind on the board
+           !(postRiverCategory == 4 && communityCategory == 4)) ||
+          // Hidden pair
+          (postRiverCategory == 2 && hasUniqueRanks(communityCards, 5)) ||
+          // Less than 21 dealer outs (most expensive check - do last)
+          getBadOuts(playerHand, usedCards, board, 21) < 21)
+      {
+        playBet = 1;
+      }
+    }
+  }
+  // 1 known flop card and 1 known dealer card
+  else if (knownDealerCards == 1 && knownFlopCards == 1 && knownTurnRiverCards == 0)
+  {
+    // Preflop
+    if (firstStreet == PREFLOP_STREET && hasPreflopRaise(getPreflopRaiseTables().knownCards[excludeFishyPlays], getKnownCardsKey(playerHand[0], playerHand[1], dealerCards[0], flop[0])))
+    {
+      playBet = 4;
+    }
+    // Postflop
+    else if (
+        firstStreet <= FLOP_STREET &&
+        // Less than 12 bad outs and we are ahead
+        getBadOutsFlop(playerHand, dealerCards, 1, getCardMask(playerHand, 2) | getCardMask(flop, 3) | getCardMask(dealerCards, 1), flopState, 12) < 12)
+    {
       playBet = 2;
     }
-    // Post-river
-    else if (
-        // At least 10 good outs
-        getGoodOuts(playerHand, communityCards, dealerCards[0], 10) >= 10 ||
-        // At least 15 good outs if best case is push
-        getGoodOuts(playerHand, communityCards, dealerCards[0], 15, true) >= 15)
+    // Post-river
+    else if (
+        // At least 10 good outs
+        getGoodOuts(playerHand, dealerCards[0], usedCards, board, 10) >= 10 ||
+        // At least 15 good outs if best case is push
+        getGoodOuts(playerHand, dealerCards[0], usedCards, board, 15, true) >= 15)
+    {
+      playBet = 1;
+    }
+  }
+  else if (knownDealerCards == 2 && knownFlopCards == 1 && knownTurnRiverCards == 2)
+  {
+    // Preflop
+    State knownCards = State().extend(flop[0]).extend(communityCards[3], communityCards[4]);
+    bool allow4xBet = !(excludeFishyPlays && isFishyHand(playerHand));
+    
+    if (firstStreet == PREFLOP_STREET && allow4xBet && knownCards.extend(playerHand[0], playerHand[1]).rank() > knownCards.extend(dealerCards[0], dealerCards[1]).rank())
+    {
+      playBet = 4;
+    }
+    else {
+      if (firstStreet <= FLOP_STREET && board.extend(playerHand[0], playerHand[1]).rank() >= board.extend(dealerCards[0], dealerCards[1]).rank())
+      {
+        playBet = 2;
+      }
+    }
+  }
+  return playBet;
+}
+
+// Strategy definitions. A strategy is plain text with one line (or
+// semicolon separated part) per street, each listing rules; the street's
+// play bet is made if any of its rules hold. The built-in strategies are:
+//
+//   preflop: 33+ A2+ K2s+ K5o+ Q6s+ Q8o+ J8s+ JTo
+//   flop: twoPair hiddenPair(3) fourFlush(T)
+//   river: twoPair hiddenPair outsBelow(21)
+//
+//   preflop: knownCards; flop: flopOutsBelow(12); river: goodOuts(10) goodOrPushOuts(15)
+//
+//   preflop: aheadOnKnownCards; flop: aheadAtRiver
+//
+// Preflop rules are hand ranges (AA, 33+, A2+, K5o+, J8s+, JTo, ...),
+// knownCards (the built-in 4x tables for a known dealer and flop card) and
+// aheadOnKnownCards. fishy(T) sets the highest unpaired high card that
+// excludeFishyPlays keeps from raising. Strategies are compiled once per
+// run into a range bit table and a short list of instructions per street.
+enum strategyOpcode
+{
+  // Flop: two pair or better, not three of a kind all on the flop. River:
+  // two pair or better, not two pair or three of a kind on the board.
+  MADE_TWO_PAIR,
+  // A pair using a hole card; pocket pairs below the parameter rank don't count
+  HIDDEN_PAIR,
+  // Four to a flush with a hole card of that suit ranked at least the parameter
+  HIDDEN_FOUR_FLUSH,
+  // River: fewer than parameter dealer cards beat the player
+  DEALER_OUTS_BELOW,
+  // Flop: fewer than parameter dealer cards put the dealer ahead
+  FLOP_OUTS_BELOW,
+  // River: at least parameter second dealer cards lose to the player (or push)
+  GOOD_OUTS,
+  GOOD_OR_PUSH_OUTS,
+  // The player's hand beats or ties the dealer's at the river
+  AHEAD_AT_RIVER
+};
+
+struct strategyInstruction
+{
+  strategyOpcode opcode;
+  int parameter;
+};
+
+const int MAX_STRATEGY_RULES = 8;
+
+struct uthStrategy
+{
+  bool hasRange;
+  bool knownCards;
+  bool aheadOnKnownCards;
+  uint64_t range[(HOLE_CARDS_KEYS + 63) / 64];
+  strategyInstruction flop[MAX_STRATEGY_RULES];
+  int flopRules;
+  strategyInstruction river[MAX_STRATEGY_RULES];
+  int riverRules;
+  int fishyHighCard = 8;
+};
+
+string getDefaultStrategy(int knownDealerCards, int knownFlopCards, int knownTurnRiverCards)
+{
+  if (knownDealerCards == 1 && knownFlopCards == 1 && knownTurnRiverCards == 0)
+    return "preflop: knownCards\nflop: flopOutsBelow(12)\nriver: goodOuts(10) goodOrPushOuts(15)";
+  if (knownDealerCards == 2 && knownFlopCards == 1 && knownTurnRiverCards == 2)
+    return "preflop: aheadOnKnownCards\nflop: aheadAtRiver";
+  return "preflop: 33+ A2+ K2s+ K5o+ Q6s+ Q8o+ J8s+ JTo\nflop: twoPair hiddenPair(3) fourFlush(T)\nriver: twoPair hiddenPair outsBelow(21)";
+}
+
+// Rank 0 (deuce) to 12 (ace) of a rank character, or -1
+int parseRank(char rank)
+{
+  const char *ranks = "23456789TJQKA";
+  const char *found = strchr(ranks, toupper(rank));
+  return rank && found ? (int)(found - ranks) : -1;
+}
+
+void setRangeHand(uint64_t *range, int rank0, int rank1, bool suited)
+{
+  // Both deal orders of the hole cards
+  int keys[2] = {(rank0 * 13 + rank1) * 2 + suited, (rank1 * 13 + rank0) * 2 + suited};
+  for (int key : keys)
+  {
+    range[key >> 6] |= 1ULL << (key & 63);
+  }
+}
+
+// Adds a hand range such as AA, 33+, A2+, K5o+, J8s+ or JTo
+bool addRange(uint64_t *range, const string &token)
+{
+  int high = token.size() >= 2 ? parseRank(token[0]) : -1;
+  int low = token.size() >= 2 ? parseRank(token[1]) : -1;
+  size_t next = 2;
+  bool suited = next < token.size() && tolower(token[next]) == 's';
+  bool offsuit = next < token.size() && tolower(token[next]) == 'o';
+  if (suited || offsuit)
+    next++;
+  bool orBetter = next < token.size() && token[next] == '+';
+  if (orBetter)
+    next++;
+  if (high < 0 || low < 0 || next != token.size() || (high == low && (suited || offsuit)))
+    return false;
+  if (low > high)
+    swap(high, low);
+  if (high == low)
+  {
+    for (int rank = low; rank <= (orBetter ? 12 : low); rank++)
+      setRangeHand(range, rank, rank, false);
+    return true;
+  }
+  for (int kicker = low; kicker <= (orBetter ? high - 1 : low); kicker++)
+  {
+    if (!offsuit)
+      setRangeHand(range, high, kicker, true);
+    if (!suited)
+      setRangeHand(range, high, kicker, false);
+  }
+  return true;
+}
+
+// Compiles a strategy for the given known cards, or returns an error
+string compileStrategy(const string &text, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, uthStrategy &strategy)
+{
+  strategy = uthStrategy();
+  string normalized = text;
+  replace(normalized.begin(), normalized.end(), ';', '\n');
+  size_t lineStart = 0;
+  while (lineStart <= normalized.size())
+  {
+    size_t lineEnd = normalized.find('\n', lineStart);
+    if (lineEnd == string::npos)
+      lineEnd = normalized.size();
+    string line = normalized.substr(lineStart, lineEnd - lineStart);
+    lineStart = lineEnd + 1;
+    size_t colon = line.find(':');
+    if (line.find_first_not_of(" \t\r") == string::npos)
+      continue;
+    if (colon == string::npos)
+      return "Strategy line without a street: " + line;
+    string street = line.substr(0, colon);
+    street.erase(0, street.find_first_not_of(" \t"));
+    street.erase(street.find_last_not_of(" \t") + 1);
+    if (street != "preflop" && street != "flop" && street != "river")
+      return "Unknown strategy street: " + street;
+
+    size_t tokenStart = colon + 1;
+    while ((tokenStart = line.find_first_not_of(" \t\r", tokenStart)) != string::npos)
+    {
+      size_t tokenEnd = line.find_first_of(" \t\r", tokenStart);
+      string token = line.substr(tokenStart, tokenEnd == string::npos ? string::npos : tokenEnd - tokenStart);
+      tokenStart = tokenEnd;
+
+      // rule or rule(parameter)
+      string rule = token;
+      string parameter;
+      size_t open = token.find('(');
+      if (open != string::npos && token.back() == ')')
+      {
+        rule = token.substr(0, open);
+        parameter = token.substr(open + 1, token.size() - open - 2);
+      }
+      int count = atoi(parameter.c_str());
+      int rank = parameter.size() == 1 ? parseRank(parameter[0]) : -1;
+
+      if (street == "preflop")
+      {
+        if (rule == "knownCards")
+        {
+          if (knownDealerCards < 1 || knownFlopCards < 1)
+            return "knownCards needs a known dealer card and flop card";
+          strategy.knownCards = true;
+        }
+        else if (rule == "fishy" && rank >= 0)
+          strategy.fishyHighCard = rank;
+        else if (rule == "aheadOnKnownCards")
+        {
+          if (knownDealerCards != 2 || knownFlopCards < 1 || knownTurnRiverCards != 2)
+            return "aheadOnKnownCards needs both dealer cards, a flop card and the turn and river known";
+          strategy.aheadOnKnownCards = true;
+        }
+        else if (addRange(strategy.range, token))
+          strategy.hasRange = true;
+        else
+          return "Unknown preflop hand range: " + token;
+        continue;
+      }
+
+      bool river = street == "river";
+      strategyInstruction instruction;
+      if (rule == "twoPair" && parameter.empty())
+        instruction = {MADE_TWO_PAIR, 0};
+      else if (rule == "hiddenPair" && (parameter.empty() || rank >= 0))
+        instruction = {HIDDEN_PAIR, max(rank, 0)};
+      else if (rule == "fourFlush" && !river && rank >= 0)
+        instruction = {HIDDEN_FOUR_FLUSH, rank};
+      else if (rule == "outsBelow" && river && count > 0)
+        instruction = {DEALER_OUTS_BELOW, count};
+      else if (rule == "flopOutsBelow" && !river && count > 0 && knownDealerCards >= 1)
+        instruction = {FLOP_OUTS_BELOW, count};
+      else if (rule == "goodOuts" && river && count > 0 && knownDealerCards >= 1)
+        instruction = {GOOD_OUTS, count};
+      else if (rule == "goodOrPushOuts" && river && count > 0 && knownDealerCards >= 1)
+        instruction = {GOOD_OR_PUSH_OUTS, count};
+      else if (rule == "aheadAtRiver" && parameter.empty() && knownDealerCards == 2 && knownTurnRiverCards == 2)
+        instruction = {AHEAD_AT_RIVER, 0};
+      else
+        return "Unknown or unusable " + street + " rule: " + token;
+
+      strategyInstruction *rules = river ? strategy.river : strategy.flop;
+      int &ruleCount = river ? strategy.riverRules : strategy.flopRules;
+      if (ruleCount == MAX_STRATEGY_RULES)
+        return "Too many " + street + " rules";
+      rules[ruleCount++] = instruction;
+    }
+  }
+  return "";
+}
+
+template <class State>
+bool isStrategyRuleMet(const strategyInstruction &instruction, bool river, const int *playerHand, const int *communityCards, const int *dealerCards, int knownDealerCards,
+                       uint64_t usedCards, const State &flopState, const State &board)
+{
+  const int *flop = communityCards;
+  const State &street = river ? board : flopState;
+  switch (instruction.opcode)
+  {
+  case MADE_TWO_PAIR:
+  {
+    int category = street.extend(playerHand[0], playerHand[1]).rank() >> 12;
+    if (river)
+    {
+      int communityCategory = board.rank() >> 12;
+      return category >= 3 && !(category == 3 && communityCategory == 3) && !(category == 4 && communityCategory == 4);
+    }
+    return category >= 3 && !(category == 4 && (flop[0] - 1) / 4 == (flop[1] - 1) / 4 && (flop[0] - 1) / 4 == (flop[2] - 1) / 4);
+  }
+  case HIDDEN_PAIR:
+  {
+    int rank0 = (playerHand[0] - 1) / 4;
+    int rank1 = (playerHand[1] - 1) / 4;
+    return street.extend(playerHand[0], playerHand[1]).rank() >> 12 == 2 && !(rank0 == rank1 && rank0 < instruction.parameter) &&
+           hasUniqueRanks(communityCards, river ? 5 : 3);
+  }
+  case HIDDEN_FOUR_FLUSH:
+  {
+    int suitCounts[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 2; i++) suitCounts[playerHand[i] % 4]++;
+    for (int i = 0; i < 3; i++) suitCounts[flop[i] % 4]++;
+    for (int i = 0; i < 2; i++)
+    {
+      if ((playerHand[i] - 1) / 4 >= instruction.parameter && suitCounts[playerHand[i] % 4] >= 4)
+        return true;
+    }
+    return false;
+  }
+  case DEALER_OUTS_BELOW:
+    return getBadOuts(playerHand, usedCards, board, instruction.parameter) < instruction.parameter;
+  case FLOP_OUTS_BELOW:
+  {
+    int dealerCount = min(knownDealerCards, 2);
+    uint64_t flopCards = getCardMask(playerHand, 2) | getCardMask(flop, 3) | getCardMask(dealerCards, dealerCount);
+    return getBadOutsFlop(playerHand, dealerCards, dealerCount, flopCards, flopState, instruction.parameter) < instruction.parameter;
+  }
+  case GOOD_OUTS:
+    return getGoodOuts(playerHand, dealerCards[0], usedCards, board, instruction.parameter) >= instruction.parameter;
+  case GOOD_OR_PUSH_OUTS:
+    return getGoodOuts(playerHand, dealerCards[0], usedCards, board, instruction.parameter, true) >= instruction.parameter;
+  case AHEAD_AT_RIVER:
+    return board.extend(playerHand[0], playerHand[1]).rank() >= board.extend(dealerCards[0], dealerCards[1]).rank();
+  }
+  return false;
+}
+
+// Play bet under a compiled strategy, or the built-in one if strategy is null
+template <class State = handState>
+int getPlayBet(const uthStrategy *strategy, const int *playerHand, const int *communityCards, const int *dealerCards, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays,
+               decisionStreet firstStreet = PREFLOP_STREET)
+{
+  if (!strategy)
+    return getPlayBet<State>(playerHand, communityCards, dealerCards, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, firstStreet);
+
+  const int *flop = communityCards;
+  State flopState = State().extend(flop, 3);
+  State board = flopState.extend(communityCards[3], communityCards[4]);
+  uint64_t usedCards = getCardMask(playerHand, 2) | getCardMask(communityCards, 5);
+
+  // Preflop
+  if (firstStreet == PREFLOP_STREET && !(excludeFishyPlays && isFishyHand(playerHand, strategy->fishyHighCard)))
+  {
+    if (strategy->hasRange && hasPreflopRaise(strategy->range, getHoleCardsKey(playerHand[0], playerHand[1])))
+      return 4;
+    // Fishy hands have been left out already, by the strategy's own cutoff
+    if (strategy->knownCards && hasPreflopRaise(getPreflopRaiseTables().knownCards[false], getKnownCardsKey(playerHand[0], playerHand[1], dealerCards[0], flop[0])))
+      return 4;
+    if (strategy->aheadOnKnownCards)
+    {
+      State knownCards = State().extend(flop[0]).extend(communityCards[3], communityCards[4]);
+      if (knownCards.extend(playerHand[0], playerHand[1]).rank() > knownCards.extend(dealerCards[0], dealerCards[1]).rank())
+        return 4;
+    }
+  }
+  // Postflop
+  for (int i = 0; firstStreet <= FLOP_STREET && i < strategy->flopRules; i++)
+  {
+    if (isStrategyRuleMet(strategy->flop[i], false, playerHand, communityCards, dealerCards, knownDealerCards, usedCards, flopState, board))
+      return 2;
+  }
+  // Post-river
+  for (int i = 0; i < strategy->riverRules; i++)
+  {
+    if (isStrategyRuleMet(strategy->river[i], true, playerHand, communityCards, dealerCards, knownDealerCards, usedCards, flopState, board))
+      return 1;
+  }
+  return 0;
+}
+
+// Profit of one hand given the play bet and both final hand ranks
+double getShowdownProfit(int playBet, int playerHandRank, int dealerHandRank)
+{
+  double profit = 0;
+  if (playerHandRank > dealerHandRank && playBet > 0)
+  {
+    // Ante bet
+    if (dealerHandRank >> 12 > 1)
+    {
+      profit += 1;
+    }
+    // Play bet
+    profit += playBet;
+    // Blind bet
+    profit += getBlindBetPayTable(playerHandRank);
+  }
+  else if (playerHandRank < dealerHandRank || playBet == 0)
+  {
+    // Ante bet
+    if (dealerHandRank >> 12 > 1 || playBet == 0)
+    {
+      profit -= 1;
+    }
+    // Play bet
+    profit -= playBet;
+    // Blind bet
+    profit -= 1;
+  }
+  return profit;
+}
+
+template <class State = handState>
+double calculateProfitUTH(const vector<int> &deck, int knownDealerCards, int knownFlopCards, int knownTurnRiverCount = 0, bool excludeFishyPlays = false, const uthStrategy *strategy = nullptr)
+{
+  const int *communityCards = deck.data();
+  const int *playerCards = deck.data() + 5;
+  const int *dealerCards = deck.data() + 7;
+  
+  int playBet = getPlayBet<State>(strategy, playerCards, communityCards, dealerCards, knownDealerCards, knownFlopCards, knownTurnRiverCount, excludeFishyPlays);
+  State board = State().extend(communityCards, 5);
+  return getShowdownProfit(playBet, board.extend(playerCards[0], playerCards[1]).rank(), board.extend(dealerCards[0], dealerCards[1]).rank());
+}
+// A run of consecutive hands in one session: their total profit and the
+// lowest running total reached, counting the start as 0. Half units.
+struct sessionSegment
+{
+  int64_t halfUnitProfit;
+  int64_t halfUnitLow;
+
+  void add(int64_t handProfit)
+  {
+    halfUnitProfit += handProfit;
+    halfUnitLow = min(halfUnitLow, halfUnitProfit);
+  }
+
+  // This segment followed by next
+  sessionSegment then(const sessionSegment &next) const
+  {
+    return sessionSegment{halfUnitProfit + next.halfUnitProfit, min(halfUnitLow, halfUnitProfit + next.halfUnitLow)};
+  }
+};
+
+const int SESSION_HISTOGRAM_BINS = 200;
+const int QUANTILE_BUCKETS = 1500;
+const double QUANTILE_GAMMA = 1.02; // Quantiles come out within about 1%
+const double SESSION_PERCENTILES[] = {1, 5, 10, 25, 50, 75, 90, 95, 99};
+
+// Constant-memory summary of every whole session's profit. Sessions go into
+// a fixed-bin histogram around 0, and into logarithmic buckets of their size
+// (one set for losses, one for wins) for the quantiles. Counts add up in any
+// order, so each thread keeps its own sketch and they merge exactly.
+struct sessionSketch
+{
+  int64_t sessions = 0;
+  int64_t losing = 0;
+  int64_t ruined = 0;
+  int64_t ruinHalfUnits = 0; // Sessions that lose this much are ruined; 0 without a bankroll
+  int64_t histogramStart = 0;
+  int64_t histogramWidth = 1;
+  vector<int64_t> histogram;
+  int64_t below = 0;
+  int64_t above = 0;
+  vector<int64_t> losses;
+  vector<int64_t> wins;
+  int64_t evens = 0;
+
+  sessionSketch() {}
+
+  // The histogram spans about 8 session stDevs either side of 0, but never
+  // below the most a session can lose
+  sessionSketch(int handsPerSession, double bankroll)
+      : ruinHalfUnits(bankroll > 0 ? (int64_t)ceil(bankroll * 2) : 0),
+        histogram(SESSION_HISTOGRAM_BINS, 0), losses(QUANTILE_BUCKETS, 0), wins(QUANTILE_BUCKETS, 0)
+  {
+    double span = 80 * sqrt((double)handsPerSession);
+    histogramWidth = max<int64_t>(1, (int64_t)ceil(span / SESSION_HISTOGRAM_BINS * 2));
+    int64_t binsBelow = min<int64_t>(SESSION_HISTOGRAM_BINS / 2, (12LL * handsPerSession + histogramWidth - 1) / histogramWidth);
+    histogramStart = -binsBelow * histogramWidth;
+  }
+
+  static int getBucket(int64_t halfUnits)
+  {
+    return (int)min<double>(QUANTILE_BUCKETS - 1, ceil(log((double)halfUnits) / log(QUANTILE_GAMMA)));
+  }
+
+  // A bucket's middle, rounded to the half units every session total is in
+  static int64_t getBucketValue(int bucket)
+  {
+    return max<int64_t>(1, llround(2 * pow(QUANTILE_GAMMA, bucket) / (QUANTILE_GAMMA + 1)));
+  }
+
+  void add(const sessionSegment &session)
+  {
+    int64_t profit = session.halfUnitProfit;
+    sessions++;
+    losing += profit < 0;
+    ruined += ruinHalfUnits > 0 && session.halfUnitLow <= -ruinHalfUnits;
+    int64_t bin = profit >= histogramStart ? (profit - histogramStart) / histogramWidth : -1;
+    if (bin < 0)
+      below++;
+    else if (bin >= SESSION_HISTOGRAM_BINS)
+      above++;
+    else
+      histogram[bin]++;
+    if (profit < 0)
+      losses[getBucket(-profit)]++;
+    else if (profit > 0)
+      wins[getBucket(profit)]++;
+    else
+      evens++;
+  }
+
+  void merge(const sessionSketch &other)
+  {
+    sessions += other.sessions;
+    losing += other.losing;
+    ruined += other.ruined;
+    below += other.below;
+    above += other.above;
+    evens += other.evens;
+    for (int i = 0; i < SESSION_HISTOGRAM_BINS; i++) histogram[i] += other.histogram[i];
+    for (int i = 0; i < QUANTILE_BUCKETS; i++)
+    {
+      losses[i] += other.losses[i];
+      wins[i] += other.wins[i];
+    }
+  }
+
+  // The session profit (in units) with a fraction q of sessions below it
+  double getQuantile(double q) const
+  {
+    int64_t rank = (int64_t)(q * (sessions - 1));
+    for (int i = QUANTILE_BUCKETS - 1; i >= 0; i--)
+    {
+      rank -= losses[i];
+      if (rank < 0)
+        return -getBucketValue(i) / 2.0;
+    }
+    rank -= evens;
+    if (rank < 0)
+      return 0;
+    for (int i = 0; i < QUANTILE_BUCKETS; i++)
+    {
+      rank -= wins[i];
+      if (rank < 0)
+        return getBucketValue(i) / 2.0;
+    }
+    return 0;
+  }
+};
+
+// What a run reports about its whole sessions, in units
+struct sessionDistribution
+{
+  int64_t sessions = 0;
+  double losingProbability = 0;
+  double riskOfRuin = -1; // -1 without a bankroll
+  vector<double> percentiles; // At SESSION_PERCENTILES
+  double histogramStart = 0;
+  double histogramWidth = 0;
+  vector<int64_t> histogram;
+  int64_t below = 0;
+  int64_t above = 0;
+};
+
+sessionDistribution getSessionDistribution(const sessionSketch &sketch)
+{
+  sessionDistribution distribution;
+  distribution.sessions = sketch.sessions;
+  if (sketch.sessions == 0)
+    return distribution;
+  distribution.losingProbability = (double)sketch.losing / sketch.sessions;
+  if (sketch.ruinHalfUnits > 0)
+    distribution.riskOfRuin = (double)sketch.ruined / sketch.sessions;
+  for (double percentile : SESSION_PERCENTILES)
+    distribution.percentiles.push_back(sketch.getQuantile(percentile / 100));
+  distribution.histogramStart = sketch.histogramStart / 2.0;
+  distribution.histogramWidth = sketch.histogramWidth / 2.0;
+  distribution.histogram = sketch.histogram;
+  distribution.below = sketch.below;
+  distribution.above = sketch.above;
+  return distribution;
+}
+
+// A scenario or strategy to play on the same deals as the rest of a run's
+// configurations. Fields left out take the run's own values.
+struct uthConfiguration
+{
+  int knownDealerCards;
+  int knownFlopCards;
+  int knownTurnRiverCards;
+  bool excludeFishyPlays;
+  string strategy; // Empty for the built-in strategy
+};
+
+const int MAX_CONFIGURATIONS = 16;
+
+struct configurationResult
+{
+  uthConfiguration configuration;
+  double profit;
+  double edge;
+  double stDev;
+  double edgeHalfWidth;
+};
+
+// first's edge minus second's, measured on the same deals
+struct edgeDifference
+{
+  int first;
+  int second;
+  double difference;
+  double halfWidth;
+};
+
+// What the pool threads pinned to one NUMA node played
+struct numaNodeCounts
+{
+  int threads = 0; // The most pinned there in any slice
+  int64_t hands = 0;
+  double seconds = 0;       // Of the slices it played in
+  double threadSeconds = 0; // Summed over its threads
+
+  void addSlice(const numaNodeCounts &slice, double sliceSeconds)
+  {
+    threads = max(threads, slice.threads);
+    hands += slice.hands;
+    seconds += slice.threads > 0 ? sliceSeconds : 0;
+    threadSeconds += slice.threadSeconds;
+  }
+};
+
+struct result
+{
+  vector<int> playerCards{};
+  vector<int> communityCards{};
+  vector<int> dealerCards{};
+  double profit = 0;
+  double edge = 0;
+  double stDev = 0;
+  string error{};
+  int64_t hands = 0;
+  bool exact = false;
+  uint64_t seed = 0;
+  double allocationsPerHand = -1; // -1 unless built with UTH_COUNT_ALLOCATIONS
+  string stopReason = "complete";
+  // Confidence interval half-widths on the edge and the session stDev
+  double edgeHalfWidth = 0;
+  double stDevHalfWidth = 0;
+  sessionDistribution sessions{}; // Uniform Monte Carlo runs only
+  // Runs given configurations only
+  vector<configurationResult> configurations{};
+  vector<edgeDifference> edgeDifferences{};
+  vector<uint8_t> shardState{}; // Sharded runs only, for mergeSimulationShards
+  vector<uint8_t> runState{};   // With returnState, for continueState
+  int shards = 0;               // Merged results only
+  profileCounts profile{};      // Monte Carlo runs in UTH_PROFILE builds only
+  outsCacheCounts outsCache{};  // Monte Carlo runs only
+  vector<numaNodeCounts> numaNodes{}; // Monte Carlo runs with NUMA replicas only
+};
+
+// A result with only an error
+result makeErrorResult(const string &message)
+{
+  result failed;
+  failed.error = message;
+  return failed;
+}
+
+enum simulationMode
+{
+  MONTE_CARLO,
+  EXACT
+};
+
+enum rngType
+{
+  SPLITMIX,
+  PHILOX
+};
+
+enum evaluatorType
+{
+  HAND_RANKS_TABLE,
+  COMPACT_EVALUATOR
+};
+
+// How Monte Carlo hands are dealt. Stratified runs deal the player every
+// two-card combo in turn and weight the results by hole-card class (or
+// combo); antithetic runs play each deal twice, the second time with the
+// player's and dealer's hole cards exchanged.
+enum samplerType
+{
+  UNIFORM_SAMPLER,
+  STRATIFIED_SAMPLER,
+  ANTITHETIC_SAMPLER
+};
+
+// Optional settings passed to runUthSimulations ahead of the callback
+struct simulationOptions
+{
+  simulationMode mode = MONTE_CARLO;
+  rngType rng = SPLITMIX;
+  // Runs with the same seed, rng and number of simulations give identical
+  // results at any thread count. A random seed is picked when not given.
+  bool hasSeed = false;
+  uint64_t seed = 0;
+  int threads = 0; // 0 uses every core
+  int batchSize = 64; // Hands dealt and evaluated together
+  evaluatorType evaluator = HAND_RANKS_TABLE;
+  string strategy; // Strategy definition text, empty for the built-in strategy
+  // Monte Carlo runs stop early, at the first checkpoint where every target
+  // given is met or once the time limit has passed. numberOfSimulations is
+  // then the most hands played.
+  double targetHalfWidth = 0;      // Confidence interval half-width on the edge
+  double targetStDevHalfWidth = 0; // and on the session stDev
+  double confidence = 0.95;
+  double timeLimitMs = 0;
+  samplerType sampler = UNIFORM_SAMPLER;
+  int strata = HOLE_CARD_CLASSES; // Or HOLE_CARD_COMBOS
+  double progressIntervalMs = 250; // Least time between progress updates
+  double bankroll = 0; // For the risk of ruin within a session, 0 for none
+  // Played on the same deals, the first in place of the run's own known
+  // cards, fishy plays and strategy
+  vector<uthConfiguration> configurations;
+  // A shard plays hands firstHand to firstHand + shardHands - 1 of the run.
+  // shardCount is 0 for a whole run.
+  int shardIndex = 0;
+  int shardCount = 0;
+  int64_t firstHand = 0;
+  int64_t shardHands = 0;
+  // Monte Carlo runs given a checkpoint file save their totals to it every
+  // checkpointIntervalMs, and with resume carry on from it
+  string checkpointFile;
+  double checkpointIntervalMs = 60000;
+  bool resume = false;
+  // A Monte Carlo run given the state of an earlier, shorter run of the same
+  // stream plays only the hands after it. With returnState the run's own state
+  // comes back for continuing later.
+  vector<uint8_t> continueState;
+  bool returnState = false;
+  string error; // An option that can't be used, reported as the run's error
+};
+
+enum stopReason
+{
+  STOP_COMPLETE,
+  STOP_TARGET,
+  STOP_TIME_LIMIT,
+  STOP_CANCELLED
+};
+
+const char *getStopReasonName(stopReason stop)
+{
+  switch (stop)
+  {
+  case STOP_TARGET:
+    return "target";
+  case STOP_TIME_LIMIT:
+    return "timeLimit";
+  case STOP_CANCELLED:
+    return "cancelled";
+  default:
+    return "complete";
+  }
+}
+
+// Early stopping is decided at every multiple of CHECKPOINT_HANDS hands and
+// nowhere else, so a run with a seed and a precision target stops at the same
+// hand on any thread count or batch size
+const int64_t CHECKPOINT_HANDS = 65536;
+
+// z such that a normal variable is within z standard deviations of its mean
+// with the given probability
+double getNormalQuantile(double confidence)
+{
+  double low = 0, high = 40;
+  for (int i = 0; i < 100; i++)
+  {
+    double z = (low + high) / 2;
+    (erfc(z / sqrt(2.0)) > 1 - confidence ? low : high) = z;
+  }
+  return (low + high) / 2;
+}
+
+double getEdgeHalfWidth(int64_t count, double sum, double sumSquares, double z)
+{
+  if (count < 2)
+    return 0;
+  double mean = sum / count;
+  return z * sqrt(max(sumSquares / count - mean * mean, 0.0) / count);
+}
+
+// Sums of powers of samples, enough for the standard error of their standard
+// deviation (by the delta method, which allows for the fat tails of session
+// profits rather than assuming they are normal)
+struct momentSums
+{
+  int64_t count = 0;
+  double sums[4] = {0, 0, 0, 0};
+
+  void add(double x)
+  {
+    count++;
+    sums[0] += x;
+    sums[1] += x * x;
+    sums[2] += x * x * x;
+    sums[3] += x * x * x * x;
+  }
+
+  // Population stDev of the values added
+  double getStDev() const
+  {
+    if (count == 0)
+      return 0;
+    double mean = sums[0] / count;
+    return sqrt(max(sums[1] / count - mean * mean, 0.0));
+  }
+
+  double getStDevHalfWidth(double z) const
+  {
+    if (count < 2)
+      return 0;
+    double mean = sums[0] / count;
+    double raw2 = sums[1] / count;
+    double variance = raw2 - mean * mean;
+    double fourth = sums[3] / count - 4 * mean * sums[2] / count + 6 * mean * mean * raw2 - 3 * mean * mean * mean * mean;
+    if (variance <= 0)
+      return 0;
+    return z * sqrt(max(fourth - variance * variance, 0.0) / count) / (2 * sqrt(variance));
+  }
+
+  void merge(const momentSums &other)
+  {
+    count += other.count;
+    for (int i = 0; i < 4; i++) sums[i] += other.sums[i];
+  }
+};
+
+enum jobState
+{
+  JOB_QUEUED,
+  JOB_RUNNING,
+  JOB_DONE,
+  JOB_CANCELLED
+};
+
+// A running job's state at a checkpoint, with the estimates merged from
+// every thread's sums so far
+struct progressUpdate
+{
+  int64_t jobId;
+  int64_t hands; // Boards in exact mode
+  int64_t numberOfSimulations;
+  double handsPerSecond;
+  bool hasEstimate; // Exact runs only count boards
+  double edge;
+  double stDev;
+  double edgeHalfWidth;
+};
+
+// One runUthSimulations call. Progress, the current share of the worker pool
+// and cancellation are per job, so concurrent runs don't disturb each other.
+struct monteCarloTotals;
+
+struct simulationJob
+{
+  int64_t id = 0;
+  int maxThreads = 0; // The run's threads option, 0 for no limit
+  std::atomic<int64_t> currentSimulationNumber{0};
+  std::atomic<int64_t> numberOfSimulations{0};
+  std::atomic<int> threads{0};
+  std::atomic<jobState> state{JOB_QUEUED};
+  std::atomic<bool> cancelled{false};
+  result finalResult; // Set before state becomes JOB_DONE or JOB_CANCELLED
+  // Pushed progress updates, called on the thread running the job
+  std::function<void(const progressUpdate &)> onProgress;
+  double progressIntervalMs = 250;
+  chrono::steady_clock::time_point lastProgress;
+  // Saves a Monte Carlo run's totals so far, called between slices
+  std::function<void(const monteCarloTotals &)> onCheckpoint;
+  double checkpointIntervalMs = 60000;
+  chrono::steady_clock::time_point lastCheckpoint;
+#ifndef _WIN32
+  cpu_set_t callerCpus; // Of the thread that started the job
+#endif
+};
+
+// Whether the job wants a progress update now
+bool isProgressDue(simulationJob &job)
+{
+  if (!job.onProgress)
+    return false;
+  auto now = chrono::steady_clock::now();
+  if (chrono::duration<double, milli>(now - job.lastProgress).count() < job.progressIntervalMs)
+    return false;
+  job.lastProgress = now;
+  return true;
+}
+
+// Whether the job wants a checkpoint now
+bool isCheckpointDue(simulationJob &job)
+{
+  if (!job.onCheckpoint)
+    return false;
+  auto now = chrono::steady_clock::now();
+  if (chrono::duration<double, milli>(now - job.lastCheckpoint).count() < job.checkpointIntervalMs)
+    return false;
+  job.lastCheckpoint = now;
+  return true;
+}
+
+inline double getRate(int64_t count, chrono::steady_clock::time_point start)
+{
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return seconds > 0 ? count / seconds : 0;
+}
+
+// The worker pool is a fixed number of threads (OMP_NUM_THREADS or every
+// core) shared by all running jobs. Jobs work in short slices and ask for
+// their share again before each one, so a new job gets cores within a few
+// milliseconds and a finished job's cores go straight back to the others.
+// At most one job per pool thread runs; the rest wait their turn.
+std::mutex SCHEDULER_mutex;
+std::condition_variable SCHEDULER_changed;
+vector<simulationJob *> runningJobs; // Ordered by thread limit, then start
+
+// Batches (Monte Carlo) or boards (exact) each pool thread takes per slice
+const int64_t SLICE_BATCHES_PER_THREAD = 64;
+const int64_t SLICE_BOARDS_PER_THREAD = 4;
+
+int getPoolSize()
+{
+  static const int poolSize = omp_get_max_threads();
+  return poolSize;
+}
+
+inline int getJobLimit(const simulationJob *job)
+{
+  return job->maxThreads > 0 ? job->maxThreads : INT32_MAX;
+}
+
+// Waits for a free pool thread, unless the job is cancelled first
+bool startJob(simulationJob &job)
+{
+#ifndef _WIN32
+  sched_getaffinity(0, sizeof(job.callerCpus), &job.callerCpus);
+#endif
+  unique_lock<mutex> lock(SCHEDULER_mutex);
+  SCHEDULER_changed.wait(lock, [&job]
+                         { return (int)runningJobs.size() < getPoolSize() || job.cancelled.load(); });
+  if (job.cancelled.load())
+    return false;
+  auto position = upper_bound(runningJobs.begin(), runningJobs.end(), &job, [](const simulationJob *a, const simulationJob *b)
+                              { return getJobLimit(a) < getJobLimit(b); });
+  runningJobs.insert(position, &job);
+  job.state.store(JOB_RUNNING);
+  return true;
+}
+
+void finishJob(simulationJob &job)
+{
+  // The thread that started the job is thread 0 of its parallel regions, so
+  // useNumaNode may have pinned it. It belongs to libuv, so it gets its own
+  // CPUs back.
+  if (threadNumaNode >= 0)
+  {
+#ifndef _WIN32
+    sched_setaffinity(0, sizeof(job.callerCpus), &job.callerCpus);
+#endif
+    threadHandRanks = &HR;
+    threadNumaNode = -1;
+  }
+  lock_guard<mutex> lock(SCHEDULER_mutex);
+  runningJobs.erase(remove(runningJobs.begin(), runningJobs.end(), &job), runningJobs.end());
+  job.threads.store(0);
+  SCHEDULER_changed.notify_all();
+}
+
+// The job's share of the pool: an even split between the running jobs, with
+// threads that lower limits leave unused going to the jobs without one
+int getJobThreads(simulationJob &job)
+{
+  lock_guard<mutex> lock(SCHEDULER_mutex);
+  int remaining = getPoolSize();
+  int jobsLeft = (int)runningJobs.size();
+  int threads = 1;
+  for (simulationJob *other : runningJobs)
+  {
+    int share = min((remaining + jobsLeft - 1) / jobsLeft, getJobLimit(other));
+    remaining -= share;
+    jobsLeft--;
+    if (other == &job)
+      threads = share;
+  }
+  job.threads.store(threads);
+  return threads;
+}
+
+void cancelJob(simulationJob &job)
+{
+  lock_guard<mutex> lock(SCHEDULER_mutex);
+  job.cancelled.store(true);
+  SCHEDULER_changed.notify_all();
+}
+
+// A board for the exact engine with the number of deals it stands in for
+struct exactBoard
+{
+  int cards[5];
+  int weight;
+};
+
+// Running totals of the exact engine. Profits are whole multiples of 0.5,
+// so doubling them keeps every sum an exact integer.
+struct exactTotals
+{
+  int64_t deals;
+  int64_t doubledProfit;
+  int64_t doubledProfitSquared;
+};
+
+const int DEALER_QUALIFIES = 2 << 12;
+
+const vector<vector<int>> &getSuitPermutations()
+{
+  static const vector<vector<int>> permutations = []
+  {
+    vector<vector<int>> all;
+    vector<int> suits = {0, 1, 2, 3};
+    do
+    {
+      all.push_back(suits);
+    } while (next_permutation(suits.begin(), suits.end()));
+    return all;
+  }();
+  return permutations;
+}
+
+// Sizes of the groups a board is dealt in. Flop and turn/river cards that are
+// known to the strategy are told apart individually, the rest only as a set,
+// so e.g. the 1-1-0 scenario deals flop[0], then {flop[1], flop[2]}, then
+// {turn, river}.
+vector<int> getBoardGroups(int knownFlopCards, int knownTurnRiverCards)
+{
+  vector<int> groups;
+  auto addStreet = [&groups](int size, int known)
+  {
+    if (known <= 0 || known >= size)
+    {
+      groups.push_back(size);
+      return;
+    }
+    for (int i = 0; i < known; i++)
+      groups.push_back(1);
+    groups.push_back(size - known);
+  };
+  addStreet(3, knownFlopCards);
+  addStreet(2, knownTurnRiverCards);
+  return groups;
+}
+
+// Relabelling suits doesn't change how a deal plays out, so each board stands
+// in for its whole suit class. Returns how many relabellings map the board
+// onto itself, or 0 if one maps it to a lexicographically smaller board (it
+// isn't the canonical member of its class).
+int getBoardStabilizer(const int *board, const vector<int> &groups)
+{
+  int stabilizer = 0;
+  for (const vector<int> &permutation : getSuitPermutations())
+  {
+    int image[5];
+    for (int i = 0; i < 5; i++)
+    {
+      image[i] = (board[i] - 1) / 4 * 4 + permutation[(board[i] - 1) % 4] + 1;
+    }
+    int offset = 0;
+    for (int size : groups)
+    {
+      sort(image + offset, image + offset + size);
+      offset += size;
+    }
+    if (lexicographical_compare(image, image + 5, board, board + 5))
+      return 0;
+    if (equal(image, image + 5, board))
+      stabilizer++;
+  }
+  return stabilizer;
+}
+
+// One board for each class of boards that differ only by suit relabellings,
+// searched on the given number of threads, or the whole pool for 0
+vector<exactBoard> getCanonicalBoards(const vector<int> &groups, int threads = 0)
+{
+  // Cards that start a new group can be any unused card, the rest of a group
+  // is dealt in increasing order
+  int groupStart[5];
+  int offset = 0;
+  for (int size : groups)
+  {
+    for (int i = 0; i < size; i++)
+      groupStart[offset + i] = offset;
+    offset += size;
+  }
+
+  // Canonical boards start with a club (any other suit can be relabelled to
+  // one), so split the work on the rank of the first card
+  vector<vector<exactBoard>> boardsByFirstCard(13);
+#pragma omp parallel for schedule(dynamic) num_threads(threads > 0 ? threads : getPoolSize())
+  for (int firstRank = 0; firstRank < 13; firstRank++)
+  {
+    int board[5];
+    bool used[53] = {false};
+    vector<exactBoard> &boards = boardsByFirstCard[firstRank];
+    std::function<void(int)> deal = [&](int depth)
+    {
+      if (depth == 5)
+      {
+        int stabilizer = getBoardStabilizer(board, groups);
+        if (stabilizer)
+        {
+          exactBoard canonical;
+          copy(board, board + 5, canonical.cards);
+          canonical.weight = 24 / stabilizer;
+          boards.push_back(canonical);
+        }
+        return;
+      }
+      int first = groupStart[depth] == depth ? 1 : board[depth - 1] + 1;
+      for (int card = first; card <= 52; card++)
+      {
+        if (used[card])
+          continue;
+        used[card] = true;
+        board[depth] = card;
+        deal(depth + 1);
+        used[card] = false;
+      }
+    };
+    board[0] = firstRank * 4 + 1;
+    used[board[0]] = true;
+    deal(1);
+  }
+
+  vector<exactBoard> boards;
+  for (auto &byFirstCard : boardsByFirstCard)
+    boards.insert(boards.end(), byFirstCard.begin(), byFirstCard.end());
+  return boards;
+}
+
+// Plays every player and dealer hand around one board. The strategy may only
+// look at the first knownDealerCards dealer cards, so the play bet is decided
+// once per visible part of the dealer hand and the hidden part is summed over.
+void enumerateExactBoard(const exactBoard &board, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, const uthStrategy *strategy, exactTotals &totals)
+{
+  bool used[53] = {false};
+  for (int i = 0; i < 5; i++)
+    used[board.cards[i]] = true;
+  int remaining[47];
+  int remainingCount = 0;
+  for (int card = 1; card <= 52; card++)
+  {
+    if (!used[card])
+      remaining[remainingCount++] = card;
+  }
+
+  // Final rank of every two card hand on this board, shared by player and dealer
+  static thread_local int handRanks[53][53];
+  const int *table = getHandRanks();
+  int boardState = 53;
+  for (int i = 0; i < 5; i++)
+    boardState = table[boardState + board.cards[i]];
+  vector<int> sortedRanks;
+  sortedRanks.reserve(remainingCount * (remainingCount - 1) / 2);
+  for (int i = 0; i < remainingCount; i++)
+  {
+    int cardState = table[boardState + remaining[i]];
+    for (int j = i + 1; j < remainingCount; j++)
+    {
+      int rank = table[cardState + remaining[j]];
+      handRanks[remaining[i]][remaining[j]] = rank;
+      handRanks[remaining[j]][remaining[i]] = rank;
+      sortedRanks.push_back(rank);
+    }
+  }
+  sort(sortedRanks.begin(), sortedRanks.end());
+
+  const int *communityCards = board.cards;
+  int64_t deals = 0;
+  int64_t doubledProfit = 0;
+  int64_t doubledProfitSquared = 0;
+  auto add = [&](double profit, int64_t count)
+  {
+    int64_t doubled = (int64_t)(profit * 2);
+    deals += count;
+    doubledProfit += doubled * count;
+    doubledProfitSquared += doubled * doubled * count;
+  };
+
+  for (int i = 0; i < remainingCount; i++)
+  {
+    for (int j = 0; j < remainingCount; j++)
+    {
+      if (i == j)
+        continue;
+      int a = remaining[i];
+      int b = remaining[j];
+      int playerHandRank = handRanks[a][b];
+      int playerCards[2] = {a, b};
+      // Dealer cards left once the player is dealt
+      int dealerPool[45];
+      int dealerPoolCount = 0;
+      for (int k = 0; k < remainingCount; k++)
+      {
+        if (k != i && k != j)
+          dealerPool[dealerPoolCount++] = remaining[k];
+      }
+
+      if (knownDealerCards <= 0)
+      {
+        int playBet = getPlayBet(strategy, playerCards, communityCards, dealerPool, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+        int64_t dealerHands = dealerPoolCount * (dealerPoolCount - 1) / 2;
+        if (playBet == 0)
+        {
+          add(getShowdownProfit(0, playerHandRank, 0), dealerHands);
+          continue;
+        }
+        // Count dealer hands below each threshold among all pairs on the
+        // board, then take out the pairs that use a player card
+        int thresholds[4] = {min(playerHandRank, DEALER_QUALIFIES), playerHandRank, playerHandRank + 1, max(playerHandRank + 1, DEALER_QUALIFIES)};
+        int64_t below[4];
+        for (int t = 0; t < 4; t++)
+          below[t] = lower_bound(sortedRanks.begin(), sortedRanks.end(), thresholds[t]) - sortedRanks.begin();
+        for (int k = 0; k < remainingCount; k++)
+        {
+          int card = remaining[k];
+          for (int t = 0; t < 4; t++)
+          {
+            if (card != a && handRanks[a][card] < thresholds[t])
+              below[t]--;
+            if (card != a && card != b && handRanks[b][card] < thresholds[t])
+              below[t]--;
+          }
+        }
+        // Wins against a non-qualifying and a qualifying dealer, pushes and
+        // losses to a non-qualifying and a qualifying dealer
+        add(getShowdownProfit(playBet, playerHandRank, 0), below[0]);
+        add(getShowdownProfit(playBet, playerHandRank, DEALER_QUALIFIES), below[1] - below[0]);
+        add(0, below[2] - below[1]);
+        add(getShowdownProfit(playBet, playerHandRank, playerHandRank + 1), below[3] - below[2]);
+        add(getShowdownProfit(playBet, playerHandRank, thresholds[3]), dealerHands - below[3]);
+      }
+      else if (knownDealerCards == 1)
+      {
+        for (int d = 0; d < dealerPoolCount; d++)
+        {
+          int dealerCard = dealerPool[d];
+          int dealerCards[2] = {dealerCard, dealerPool[d == 0 ? 1 : 0]};
+          int playBet = getPlayBet(strategy, playerCards, communityCards, dealerCards, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+          for (int e = 0; e < dealerPoolCount; e++)
+          {
+            if (e != d)
+              add(getShowdownProfit(playBet, playerHandRank, handRanks[dealerCard][dealerPool[e]]), 1);
+          }
+        }
+      }
+      else
+      {
+        for (int d = 0; d < dealerPoolCount; d++)
+        {
+          for (int e = 0; e < dealerPoolCount; e++)
+          {
+            if (e == d)
+              continue;
+            int dealerCards[2] = {dealerPool[d], dealerPool[e]};
+            int playBet = getPlayBet(strategy, playerCards, communityCards, dealerCards, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+            add(getShowdownProfit(playBet, playerHandRank, handRanks[dealerPool[d]][dealerPool[e]]), 1);
+          }
+        }
+      }
+    }
+  }
+
+  totals.deals += deals * board.weight;
+  totals.doubledProfit += doubledProfit * board.weight;
+  totals.doubledProfitSquared += doubledProfitSquared * board.weight;
+}
+
+// Exact edge of the strategy in getPlayBet over every possible deal
+result runExactUth(int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, const uthStrategy *strategy, simulationJob &job)
+{
+  vector<exactBoard> boards = getCanonicalBoards(getBoardGroups(knownFlopCards, knownTurnRiverCards), getJobThreads(job));
+  // Progress is reported in boards for this mode
+  job.numberOfSimulations.store(boards.size());
+  auto start = chrono::steady_clock::now();
+  exactTotals totals{0, 0, 0};
+
+  for (int64_t nextBoard = 0; nextBoard < (int64_t)boards.size() && !job.cancelled.load(std::memory_order_relaxed);)
+  {
+    int threads = getJobThreads(job);
+    int64_t sliceEnd = min<int64_t>(boards.size(), nextBoard + threads * SLICE_BOARDS_PER_THREAD);
+#pragma omp parallel num_threads(threads)
     {
-      playBet = 1;
+      useNumaNode(omp_get_thread_num());
+      exactTotals localTotals{0, 0, 0};
+#pragma omp for schedule(dynamic) nowait
+      for (int64_t i = nextBoard; i < sliceEnd; i++)
+      {
+        enumerateExactBoard(boards[i], knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy, localTotals);
+        job.currentSimulationNumber.fetch_add(1, std::memory_order_relaxed);
+      }
+#pragma omp critical
+      {
+        totals.deals += localTotals.deals;
+        totals.doubledProfit += localTotals.doubledProfit;
+        totals.doubledProfitSquared += localTotals.doubledProfitSquared;
+      }
     }
+    nextBoard = sliceEnd;
+    if (isProgressDue(job))
+      job.onProgress(progressUpdate{job.id, nextBoard, (int64_t)boards.size(), getRate(nextBoard, start), false, 0, 0, 0});
   }
-  else if (knownDealerCards == 2 && knownFlopCards == 1 && knownTurnRiverCards == 2)
+  if (job.cancelled.load())
+    return makeErrorResult("Simulation cancelled");
+
+  double profit = totals.doubledProfit / 2.0;
+  double edge = profit / totals.deals;
+  double variance = totals.doubledProfitSquared / 4.0 / totals.deals - edge * edge;
+  // Same meaning as the Monte Carlo stDev: spread of a session's total profit
+  double stDev = sqrt(max(variance, 0.0) * handsPerSession);
+  result exactResult{{}, {}, {}, profit, edge, stDev, ""};
+  exactResult.hands = totals.deals;
+  exactResult.exact = true;
+  return exactResult;
+}
+
+// Names of the streets and of the two actions open on each. The second action
+// checks, or folds on the river.
+const char *const STREET_NAMES[3] = {"preflop", "flop", "river"};
+const char *const STREET_ACTIONS[3][2] = {{"raise4x", "check"}, {"bet2x", "check"}, {"call1x", "fold"}};
+const int STREET_BETS[3] = {4, 2, 1};
+
+// Exact EVs of both actions on one street for a partly known deal
+struct handEvs
+{
+  int street;
+  int64_t deals;
+  double evs[2];
+  int strategyAction;
+  int bestAction;
+  double milliseconds;
+  string error;
+};
+
+// Exact EV of each action on a street for the known cards, in deck order with
+// 0 for an unknown card, over every way to deal the unknown ones. After a
+// check the strategy plays the later streets. A negative street picks the
+// latest one the known community cards reach.
+handEvs getHandEvs(const int *cards, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, const uthStrategy *strategy, int street, int threads)
+{
+  auto start = chrono::steady_clock::now();
+  handEvs evs{0, 0, {0, 0}, 0, 0, 0, ""};
+  bool used[53] = {false};
+  for (int i = 0; i < DEALT_CARDS; i++)
+  {
+    if (cards[i] < 0 || cards[i] > 52)
+    {
+      evs.error = "Cards must be 1 to 52, or 0 when unknown";
+      return evs;
+    }
+    if (cards[i] && used[cards[i]])
+    {
+      evs.error = "Card " + std::to_string(cards[i]) + " is given twice";
+      return evs;
+    }
+    used[cards[i]] = true;
+  }
+  if (!cards[5] || !cards[6])
+  {
+    evs.error = "Both hole cards must be given";
+    return evs;
+  }
+  bool flopKnown = cards[0] && cards[1] && cards[2];
+  if (street < 0)
+    street = flopKnown && cards[3] && cards[4] ? RIVER_STREET : flopKnown ? FLOP_STREET : PREFLOP_STREET;
+  evs.street = street = min<int>(street, RIVER_STREET);
+  // The strategy's decision on this street can only use cards it has seen by then
+  for (int i = 0; i < 5; i++)
+  {
+    bool seen = street == RIVER_STREET || (i < 3 ? street == FLOP_STREET || i < knownFlopCards : i - 3 < knownTurnRiverCards);
+    if (seen && !cards[i])
+    {
+      evs.error = "Community card " + std::to_string(i + 1) + " is seen by the " + STREET_NAMES[street] + " and must be given";
+      return evs;
+    }
+  }
+  for (int i = 0; i < knownDealerCards && i < 2; i++)
+  {
+    if (!cards[7 + i])
+    {
+      evs.error = "Dealer card " + std::to_string(i + 1) + " is seen by the " + STREET_NAMES[street] + " and must be given";
+      return evs;
+    }
+  }
+
+  // Unknown community cards are dealt as a set, then split over their
+  // positions. Within a group the order doesn't matter to the strategy, so a
+  // split only deals each group in increasing order and stands in for the rest.
+  vector<int> groups = getBoardGroups(knownFlopCards, knownTurnRiverCards);
+  int groupOf[5];
+  for (int g = 0, offset = 0; g < (int)groups.size(); offset += groups[g++])
+  {
+    for (int i = 0; i < groups[g]; i++)
+      groupOf[offset + i] = g;
+  }
+  int unknownPositions[5];
+  int unknownCount = 0;
+  int64_t splitWeight = 1;
+  int unknownInGroup[5] = {0};
+  for (int i = 0; i < 5; i++)
+  {
+    if (!cards[i])
+    {
+      unknownPositions[unknownCount++] = i;
+      splitWeight *= ++unknownInGroup[groupOf[i]];
+    }
+  }
+  vector<array<int, 5>> splits;
+  array<int, 5> order = {0, 1, 2, 3, 4};
+  do
+  {
+    bool increasing = true;
+    for (int i = 1; i < unknownCount; i++)
+    {
+      if (groupOf[unknownPositions[i]] == groupOf[unknownPositions[i - 1]] && order[i] < order[i - 1])
+        increasing = false;
+    }
+    if (increasing)
+      splits.push_back(order);
+  } while (next_permutation(order.begin(), order.begin() + unknownCount));
+
+  // Suits with no known card can be relabelled, so only the smallest set of
+  // unknown community cards in each class is played
+  bool suitKnown[4] = {false};
+  for (int i = 0; i < DEALT_CARDS; i++)
+  {
+    if (cards[i])
+      suitKnown[(cards[i] - 1) % 4] = true;
+  }
+  vector<const vector<int> *> relabellings;
+  for (const vector<int> &permutation : getSuitPermutations())
+  {
+    bool fixesKnown = true;
+    for (int suit = 0; suit < 4; suit++)
+      fixesKnown = fixesKnown && (!suitKnown[suit] || permutation[suit] == suit);
+    if (fixesKnown)
+      relabellings.push_back(&permutation);
+  }
+  int remaining[52];
+  int remainingCount = 0;
+  for (int card = 1; card <= 52; card++)
+  {
+    if (!used[card])
+      remaining[remainingCount++] = card;
+  }
+  int unknownDealerCards = !cards[7] + !cards[8];
+
+  // What the strategy picks doesn't depend on cards it hasn't seen yet, so
+  // any completion tells
+  int filled[DEALT_CARDS];
+  copy(cards, cards + DEALT_CARDS, filled);
+  for (int i = 0, next = 0; i < DEALT_CARDS; i++)
+  {
+    if (!filled[i])
+      filled[i] = remaining[next++];
+  }
+  int strategyBet = getPlayBet(strategy, filled + 5, filled, filled + 7, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, (decisionStreet)street);
+  evs.strategyAction = strategyBet == STREET_BETS[street] ? 0 : 1;
+
+  // Runs as a job for the scheduler, taking its share of the pool up to
+  // the threads asked for
+  simulationJob job;
+  job.maxThreads = threads;
+  startJob(job);
+  threads = getJobThreads(job);
+  int64_t deals = 0;
+  int64_t doubledProfits[2] = {0, 0};
+#pragma omp parallel num_threads(threads)
+  {
+    useNumaNode(omp_get_thread_num());
+    const int *table = getHandRanks();
+    int64_t localDeals = 0;
+    int64_t localProfits[2] = {0, 0};
+    int deal[DEALT_CARDS];
+    copy(cards, cards + DEALT_CARDS, deal);
+    int unknown[5];
+    bool inSet[53] = {false};
+
+    auto playSet = [&]()
+    {
+      int stabilizer = 0;
+      for (const vector<int> *permutation : relabellings)
+      {
+        // Relabelled cards are kept in increasing order as they're made
+        int image[5];
+        for (int i = 0; i < unknownCount; i++)
+        {
+          int card = (unknown[i] - 1) / 4 * 4 + (*permutation)[(unknown[i] - 1) % 4] + 1;
+          int j = i;
+          for (; j > 0 && image[j - 1] > card; j--)
+            image[j] = image[j - 1];
+          image[j] = card;
+        }
+        if (lexicographical_compare(image, image + unknownCount, unknown, unknown + unknownCount))
+          return;
+        if (equal(image, image + unknownCount, unknown))
+          stabilizer++;
+      }
+      int64_t weight = (int64_t)relabellings.size() / stabilizer * splitWeight;
+
+      // Count dealer hands in the same buckets as the exact engine: below the
+      // player and not qualifying, below and qualifying, pushes, above and not
+      // qualifying, above and qualifying
+      for (int i = 0; i < unknownCount; i++)
+        deal[unknownPositions[i]] = unknown[i];
+      int boardState = 53;
+      for (int i = 0; i < 5; i++)
+        boardState = table[boardState + deal[i]];
+      int playerHandRank = table[table[boardState + deal[5]] + deal[6]];
+      int thresholds[4] = {min(playerHandRank, DEALER_QUALIFIES), playerHandRank, playerHandRank + 1, max(playerHandRank + 1, DEALER_QUALIFIES)};
+      int64_t dealerHands[5] = {0};
+      auto addDealerHand = [&](int rank, int64_t count)
+      {
+        dealerHands[(rank >= thresholds[0]) + (rank >= thresholds[1]) + (rank >= thresholds[2]) + (rank >= thresholds[3])] += count;
+      };
+      int dealerPool[52];
+      int dealerPoolCount = 0;
+      for (int k = 0; k < remainingCount; k++)
+      {
+        if (!inSet[remaining[k]])
+          dealerPool[dealerPoolCount++] = remaining[k];
+      }
+      if (unknownDealerCards == 0)
+        addDealerHand(table[table[boardState + deal[7]] + deal[8]], 1);
+      else if (unknownDealerCards == 1)
+      {
+        int dealerState = table[boardState + (cards[7] ? cards[7] : cards[8])];
+        for (int k = 0; k < dealerPoolCount; k++)
+          addDealerHand(table[dealerState + dealerPool[k]], 1);
+      }
+      else
+      {
+        // Each pair is dealt in either order
+        for (int k = 0; k < dealerPoolCount; k++)
+        {
+          int cardState = table[boardState + dealerPool[k]];
+          for (int l = k + 1; l < dealerPoolCount; l++)
+            addDealerHand(table[cardState + dealerPool[l]], 2);
+        }
+      }
+      int representatives[5] = {0, DEALER_QUALIFIES, playerHandRank, playerHandRank + 1, thresholds[3]};
+      int64_t dealerDeals = 0;
+      int64_t betProfits[5] = {0};
+      for (int bucket = 0; bucket < 5; bucket++)
+      {
+        dealerDeals += dealerHands[bucket];
+        for (int bet = 0; bet <= 4; bet++)
+          betProfits[bet] += (int64_t)(getShowdownProfit(bet, playerHandRank, representatives[bucket]) * 2) * dealerHands[bucket];
+      }
+
+      // Dealer cards the strategy can't see yet only need to be real cards
+      for (int i = 7, next = 0; i < DEALT_CARDS; i++)
+      {
+        if (!cards[i])
+          deal[i] = dealerPool[next++];
+      }
+      for (const array<int, 5> &split : splits)
+      {
+        for (int i = 0; i < unknownCount; i++)
+          deal[unknownPositions[i]] = unknown[split[i]];
+        int checkBet = street == RIVER_STREET ? 0 : getPlayBet(strategy, deal + 5, deal, deal + 7, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, (decisionStreet)(street + 1));
+        localProfits[0] += betProfits[STREET_BETS[street]] * weight;
+        localProfits[1] += betProfits[checkBet] * weight;
+        localDeals += dealerDeals * weight;
+      }
+    };
+    std::function<void(int, int)> dealSet = [&](int depth, int from)
+    {
+      if (depth == unknownCount)
+      {
+        playSet();
+        return;
+      }
+      for (int k = from; k < remainingCount; k++)
+      {
+        unknown[depth] = remaining[k];
+        inSet[remaining[k]] = true;
+        dealSet(depth + 1, k + 1);
+        inSet[remaining[k]] = false;
+      }
+    };
+
+    // Split the work on the first unknown community card
+#pragma omp for schedule(dynamic) nowait
+    for (int first = 0; first < (unknownCount ? remainingCount : 1); first++)
+    {
+      if (!unknownCount)
+      {
+        playSet();
+        continue;
+      }
+      unknown[0] = remaining[first];
+      inSet[remaining[first]] = true;
+      dealSet(1, first + 1);
+      inSet[remaining[first]] = false;
+    }
+#pragma omp critical
+    {
+      deals += localDeals;
+      doubledProfits[0] += localProfits[0];
+      doubledProfits[1] += localProfits[1];
+    }
+  }
+  finishJob(job);
+
+  evs.deals = deals;
+  for (int action = 0; action < 2; action++)
+    evs.evs[action] = deals > 0 ? doubledProfits[action] / 2.0 / deals : 0;
+  evs.bestAction = evs.evs[0] > evs.evs[1] ? 0 : 1;
+  evs.milliseconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000;
+  return evs;
+}
+
+// A configuration ready to play, with its strategy compiled for its known cards
+struct configurationPlay
+{
+  int knownDealerCards;
+  int knownFlopCards;
+  int knownTurnRiverCards;
+  bool excludeFishyPlays;
+  const uthStrategy *strategy;
+};
+
+// Configuration sums hold each configuration's total profit, then the total
+// of every product of two configurations' profits on the same deal: a with b
+// for a <= b, in that order. Half units.
+inline int getConfigurationSumsSize(int configurations)
+{
+  return configurations + configurations * (configurations + 1) / 2;
+}
+
+inline int getProductIndex(int a, int b, int configurations)
+{
+  return configurations + a * configurations - a * (a - 1) / 2 + (b - a);
+}
+
+inline void addConfigurationProfits(int64_t *sums, const int64_t *profits, int configurations)
+{
+  int64_t *products = sums + configurations;
+  for (int a = 0; a < configurations; a++)
+  {
+    sums[a] += profits[a];
+    for (int b = a; b < configurations; b++)
+      *products++ += profits[a] * profits[b];
+  }
+}
+
+// A stratum's sums for stratified sampling, in half units
+struct stratumSums
+{
+  int64_t hands;
+  int64_t halfUnitProfit;
+  int64_t halfUnitProfitSquared;
+};
+
+// Sums over the hands a Monte Carlo run played: always its first hands hands,
+// even when it stops early. Profits are in half units. A run handed totals
+// from a checkpoint carries on from them.
+struct monteCarloTotals
+{
+  int64_t hands = 0;
+  int64_t halfUnitProfit = 0;
+  int64_t halfUnitProfitSquared = 0;
+  int64_t allocations = 0;
+  stopReason stop = STOP_COMPLETE;
+  // Whole sessions, for uniform runs only
+  momentSums sessionMoments; // Of their profits in units, added in session order
+  sessionSketch sessions;
+  sessionSegment partialSession{0, 0}; // Of the session the hands end in
+  // Stratified and antithetic runs only
+  vector<stratumSums> strata;
+  int64_t halfUnitPairSquares = 0; // Squares of antithetic pairs' profits
+  momentSums handMoments;          // Of single hands' profits, in units
+  vector<int64_t> configurationSums; // Runs given configurations only
+  profileCounts profile;             // UTH_PROFILE builds only
+  outsCacheCounts outsCache;
+  vector<numaNodeCounts> numaNodes; // This process's part only, never saved
+};
+
+inline int getStratum(int64_t hand, int strata)
+{
+  int combo = (int)(hand % HOLE_CARD_COMBOS);
+  return strata == HOLE_CARD_COMBOS ? combo : HOLE_CARD_STRATA.classes[combo];
+}
+
+inline double getStratumWeight(int stratum, int strata)
+{
+  return (strata == HOLE_CARD_COMBOS ? 1 : HOLE_CARD_STRATA.classCombos[stratum]) / (double)HOLE_CARD_COMBOS;
+}
+
+// The edge, its confidence interval half-width and the variance of a single
+// hand's profit, weighted for the way the hands were sampled
+struct sampledEstimate
+{
+  double edge;
+  double edgeHalfWidth;
+  double handVariance;
+};
+
+sampledEstimate getSampledEstimate(const monteCarloTotals &totals, const simulationOptions &options, double z)
+{
+  sampledEstimate estimate{0, 0, 0};
+  if (totals.hands == 0)
+    return estimate;
+  double profit = totals.halfUnitProfit / 2.0;
+  double profitSquared = totals.halfUnitProfitSquared / 4.0;
+  estimate.edge = profit / totals.hands;
+  estimate.handVariance = max(profitSquared / totals.hands - estimate.edge * estimate.edge, 0.0);
+  if (options.sampler == ANTITHETIC_SAMPLER)
+  {
+    // Pairs are the independent samples; their mean profit is the estimate
+    int64_t pairs = totals.hands / 2;
+    double pairVariance = totals.halfUnitPairSquares / 16.0 / pairs - estimate.edge * estimate.edge;
+    estimate.edgeHalfWidth = pairs > 1 ? z * sqrt(max(pairVariance, 0.0) / pairs) : 0;
+  }
+  else if (options.sampler == STRATIFIED_SAMPLER)
+  {
+    // Strata not dealt yet (only in runs shorter than a round of combos)
+    // leave the weights of the others to be renormalised
+    double weights = 0, edge = 0, meanSquare = 0, edgeVariance = 0;
+    for (int stratum = 0; stratum < (int)totals.strata.size(); stratum++)
+    {
+      const stratumSums &sums = totals.strata[stratum];
+      if (sums.hands == 0)
+        continue;
+      double weight = getStratumWeight(stratum, options.strata);
+      double mean = sums.halfUnitProfit / 2.0 / sums.hands;
+      double variance = sums.hands > 1 ? max(sums.halfUnitProfitSquared / 4.0 / sums.hands - mean * mean, 0.0) : estimate.handVariance;
+      weights += weight;
+      edge += weight * mean;
+      meanSquare += weight * (variance + mean * mean);
+      edgeVariance += weight * weight * variance / sums.hands;
+    }
+    estimate.edge = edge / weights;
+    estimate.handVariance = max(meanSquare / weights - estimate.edge * estimate.edge, 0.0);
+    estimate.edgeHalfWidth = z * sqrt(edgeVariance) / weights;
+  }
+  else
+    estimate.edgeHalfWidth = getEdgeHalfWidth(totals.hands, profit, profitSquared, z);
+  return estimate;
+}
+
+// Deals the batch's hands, numbered from firstHandNumber, from deck, which is
+// back in its base order after each one
+template <class Rng>
+DISPATCHED_KERNEL void dealHandBatch(handBatch &batch, int *deck, uint64_t seed, int64_t firstHandNumber, samplerType sampler)
+{
+  int swaps[DEALT_CARDS];
+  for (int i = 0; i < batch.size; i++)
+  {
+    int64_t handNumber = firstHandNumber + i;
+    const int *layout = DEALT_LAYOUT;
+    if (sampler == STRATIFIED_SAMPLER)
+    {
+      Rng rng(seed, handNumber);
+      const int *holeCards = HOLE_CARD_STRATA.cards[handNumber % HOLE_CARD_COMBOS];
+      dealCardsWith(deck, swaps, rng, holeCards[0], holeCards[1]);
+      layout = FIXED_PLAYER_LAYOUT;
+    }
+    else if (sampler == ANTITHETIC_SAMPLER)
+    {
+      Rng rng(seed, handNumber / 2);
+      dealCards(deck, swaps, rng);
+      layout = handNumber % 2 ? EXCHANGED_LAYOUT : DEALT_LAYOUT;
+    }
+    else
+    {
+      Rng rng(seed, handNumber);
+      dealCards(deck, swaps, rng);
+    }
+    for (int k = 0; k < DEALT_CARDS; k++)
+    {
+      batch.card(k)[i] = deck[layout[k]];
+    }
+    undealCards(deck, swaps);
+  }
+}
+
+// Decides the play bet of each hand in the batch, and each other configuration's
+// into otherPlayBets, one batch capacity per configuration
+template <class State>
+DISPATCHED_KERNEL void decidePlayBets(handBatch &batch, const uthStrategy *strategy, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays,
+                                      const vector<configurationPlay> &others, int *otherPlayBets)
+{
+  int hand[DEALT_CARDS];
+  for (int i = 0; i < batch.size; i++)
+  {
+    for (int k = 0; k < DEALT_CARDS; k++) hand[k] = batch.card(k)[i];
+    batch.playBets[i] = getPlayBet<State>(strategy, hand + 5, hand, hand + 7, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+    PROFILE_COUNT(batch.playBets[i] == 4 ? PROFILE_RAISES_4X : PROFILE_FOLDS + batch.playBets[i]);
+    for (size_t c = 0; c < others.size(); c++)
+    {
+      const configurationPlay &other = others[c];
+      otherPlayBets[c * batch.capacity + i] = getPlayBet<State>(other.strategy, hand + 5, hand, hand + 7, other.knownDealerCards, other.knownFlopCards, other.knownTurnRiverCards, other.excludeFishyPlays);
+    }
+  }
+}
+
+// Monte Carlo core. Hands are dealt from per-hand generator streams, so every
+// hand is the same whichever thread plays it. Profits are summed in half
+// units: every payout is a multiple of 0.5, so the sums (and session totals)
+// stay exact integers and come out identical at any thread count.
+//
+// Hands are played in batches of batchSize: a batch is dealt into
+// structure-of-arrays buffers, the play bets are decided hand by hand, and
+// then the showdown lookups run for the whole batch at once.
+//
+// Slices end on checkpoints, where the threads' running sums are merged and
+// the stopping rules are checked. A slice interrupted by cancellation is
+// dropped, so the totals always cover a whole prefix of the hands.
+template <class Rng, class State>
+void simulateUthHands(uint64_t seed, int64_t sims, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, simulationJob &job,
+                      const simulationOptions &options, const uthStrategy *strategy, const vector<configurationPlay> &others, monteCarloTotals &totals)
+{
+  auto start = chrono::steady_clock::now();
+  int batchSize = options.batchSize;
+  double z = getNormalQuantile(options.confidence);
+  samplerType sampler = options.sampler;
+  // Antithetic pairs stay within a batch
+  if (sampler == ANTITHETIC_SAMPLER)
+  {
+    batchSize += batchSize % 2;
+    sims -= sims % 2;
+  }
+  // Only whole sessions count towards the session stDev and distribution.
+  // Other samplers deal sessions that aren't independent, so they use the
+  // single hands' spread instead.
+  bool sessionStats = sampler == UNIFORM_SAMPLER;
+  // Each batch writes its part of every session it touches to segments, at
+  // batchNumber + the session's offset in the slice, which keeps a session's
+  // parts together in order. Whole sessions are then put together in
+  // parallel, and a session the slice ends in is carried to the next one (as
+  // the totals' partial session), so
+  // memory depends on the slice size rather than the length of the run.
+  int64_t maxSliceHands = (int64_t)getPoolSize() * SLICE_BATCHES_PER_THREAD * batchSize + CHECKPOINT_HANDS;
+  int64_t maxSliceSessions = maxSliceHands / handsPerSession + 2;
+  vector<sessionSegment> segments(sessionStats ? maxSliceHands / batchSize + 1 + maxSliceSessions : 0);
+  vector<int64_t> sliceSessionProfits(sessionStats ? maxSliceSessions : 0);
+  vector<sessionSketch> threadSketches(sessionStats ? getPoolSize() : 0, sessionSketch(handsPerSession, options.bankroll));
+  if (sessionStats && totals.sessions.sessions > 0)
+    threadSketches[0] = totals.sessions;
+  // Configurations after the first are played on the same deals, reusing
+  // their showdown ranks
+  int configurations = others.empty() ? 0 : (int)others.size() + 1;
+  int configurationSumsSize = configurations ? getConfigurationSumsSize(configurations) : 0;
+  if (totals.configurationSums.size() != (size_t)configurationSumsSize)
+    totals.configurationSums.assign(configurationSumsSize, 0);
+  vector<int64_t> sliceConfigurationSums(configurationSumsSize);
+  vector<int64_t> threadConfigurationSums(configurationSumsSize * getPoolSize());
+  vector<int64_t> threadConfigurationProfits(configurations * getPoolSize());
+  vector<int> threadOtherPlayBets(others.size() * batchSize * getPoolSize());
+  int strata = sampler == STRATIFIED_SAMPLER ? options.strata : 0;
+  if (totals.strata.size() != (size_t)strata)
+    totals.strata.assign(strata, stratumSums{0, 0, 0});
+  vector<stratumSums> sliceStrata(strata);
+  vector<stratumSums> threadStrata(strata * getPoolSize());
+  // Build the decision tables up front rather than inside the first hand
+  getPreflopRaiseTables();
+
+  // Each pool thread deals from its own copy of the deck, restored after every
+  // hand, into its own batch buffers. They outlive the slices, so a change in
+  // the job's share of the pool doesn't reallocate them.
+  vector<int> decks;
+  vector<handBatch> threadBatches;
+  for (int t = 0; t < getPoolSize(); t++)
+  {
+    decks.insert(decks.end(), baseDeck, baseDeck + 52);
+    threadBatches.emplace_back(batchSize);
+  }
+  if (totals.numaNodes.size() != (size_t)HR_numa.nodes)
+    totals.numaNodes.assign(HR_numa.nodes, numaNodeCounts());
+  vector<numaNodeCounts> sliceNuma(HR_numa.nodes);
+
+  bool stopsEarly = options.targetHalfWidth > 0 || options.targetStDevHalfWidth > 0 || options.timeLimitMs > 0;
+  while (totals.hands < sims && totals.stop == STOP_COMPLETE)
+  {
+    int threads = getJobThreads(job);
+    int64_t sliceStart = totals.hands;
+    int64_t sliceHands = threads * SLICE_BATCHES_PER_THREAD * batchSize;
+    int64_t sliceEnd = min(sims, (sliceStart + sliceHands + CHECKPOINT_HANDS - 1) / CHECKPOINT_HANDS * CHECKPOINT_HANDS);
+    // Runs that can stop early end every slice at the next boundary, so the
+    // stop rule sees each one whatever the thread count and batch size
+    if (stopsEarly)
+      sliceEnd = min(sliceEnd, (sliceStart / CHECKPOINT_HANDS + 1) * CHECKPOINT_HANDS);
+    int64_t sliceBatches = (sliceEnd - sliceStart + batchSize - 1) / batchSize;
+    int64_t sliceFirstSession = sliceStart / handsPerSession;
+    int64_t sliceSessionsEnd = sliceEnd / handsPerSession; // Whole sessions end before this one
+    // A session's parts from this slice, after any part carried from the last
+    auto getSliceSession = [&](int64_t session)
+    {
+      int64_t first = max(session * handsPerSession, sliceStart);
+      int64_t last = min((session + 1) * handsPerSession, sliceEnd) - 1;
+      sessionSegment whole = session * handsPerSession < sliceStart ? totals.partialSession : sessionSegment{0, 0};
+      for (int64_t b = (first - sliceStart) / batchSize; b <= (last - sliceStart) / batchSize; b++)
+        whole = whole.then(segments[b + session - sliceFirstSession]);
+      return whole;
+    };
+    int64_t sliceProfit = 0;
+    int64_t sliceProfitSquared = 0;
+    int64_t slicePairSquares = 0;
+    momentSums sliceHandMoments;
+    fill(sliceStrata.begin(), sliceStrata.end(), stratumSums{0, 0, 0});
+    fill(sliceConfigurationSums.begin(), sliceConfigurationSums.end(), 0);
+    fill(sliceNuma.begin(), sliceNuma.end(), numaNodeCounts());
+    bool sliceComplete = true;
+    auto sliceStartTime = chrono::steady_clock::now();
+#pragma omp parallel num_threads(threads)
+    {
+      int numaNode = useNumaNode(omp_get_thread_num());
+      // Thread-local variables for incremental statistics
+      int64_t localTotalProfit = 0;
+      int64_t localTotalProfitSquared = 0;
+      int64_t localPairSquares = 0;
+      int64_t localProgress = 0;
+      int64_t localHands = 0;
+      momentSums localHandMoments;
+      stratumSums *localStrata = threadStrata.data() + omp_get_thread_num() * strata;
+      fill(localStrata, localStrata + strata, stratumSums{0, 0, 0});
+      int64_t *localConfigurationSums = threadConfigurationSums.data() + omp_get_thread_num() * configurationSumsSize;
+      fill(localConfigurationSums, localConfigurationSums + configurationSumsSize, 0);
+      int64_t *configurationProfits = threadConfigurationProfits.data() + omp_get_thread_num() * configurations;
+      int *otherPlayBets = threadOtherPlayBets.data() + omp_get_thread_num() * others.size() * batchSize;
+      bool skippedBatches = false;
+
+      int *newDeck = decks.data() + omp_get_thread_num() * 52;
+      handBatch &batch = threadBatches[omp_get_thread_num()];
+      int64_t startAllocations = getThreadAllocations();
+      outsCacheCounts startOutsCache = threadOutsCache;
+#ifdef UTH_PROFILE
+      profileCounts startProfile = threadProfile;
+#endif
+
+#pragma omp for schedule(dynamic) nowait
+      for (int64_t batchNumber = 0; batchNumber < sliceBatches; batchNumber++)
+      {
+        if (job.cancelled.load(std::memory_order_relaxed))
+        {
+          skippedBatches = true;
+          continue;
+        }
+        int64_t firstHand = sliceStart + batchNumber * batchSize;
+        batch.size = (int)min<int64_t>(batchSize, sliceEnd - firstHand);
+        PROFILE_BATCH_START(batchNumber);
+        // Shards number their hands as in the whole run
+        dealHandBatch<Rng>(batch, newDeck, seed, options.firstHand + firstHand, sampler);
+        PROFILE_PHASE_END(PHASE_SHUFFLE);
+        decidePlayBets<State>(batch, strategy, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, others, otherPlayBets);
+        PROFILE_PHASE_END(PHASE_PLAY_BET);
+        evaluateHandBatch<State>(batch);
+        PROFILE_PHASE_END(PHASE_SHOWDOWN);
+
+        int64_t session = firstHand / handsPerSession;
+        sessionSegment segment{0, 0};
+        for (int i = 0; i < batch.size; i++)
+        {
+          int64_t handProfit = (int64_t)(getShowdownProfit(batch.playBets[i], batch.playerRanks[i], batch.dealerRanks[i]) * 2);
+          localTotalProfit += handProfit;
+          localTotalProfitSquared += handProfit * handProfit;
+          if (configurations)
+          {
+            configurationProfits[0] = handProfit;
+            for (size_t c = 0; c < others.size(); c++)
+              configurationProfits[c + 1] = (int64_t)(getShowdownProfit(otherPlayBets[c * batchSize + i], batch.playerRanks[i], batch.dealerRanks[i]) * 2);
+            addConfigurationProfits(localConfigurationSums, configurationProfits, configurations);
+          }
+          if (sessionStats)
+          {
+            int64_t handSession = (firstHand + i) / handsPerSession;
+            if (handSession != session)
+            {
+              segments[batchNumber + session - sliceFirstSession] = segment;
+              session = handSession;
+              segment = sessionSegment{0, 0};
+            }
+            segment.add(handProfit);
+            continue;
+          }
+          localHandMoments.add(handProfit / 2.0);
+          if (sampler == STRATIFIED_SAMPLER)
+          {
+            stratumSums &sums = localStrata[getStratum(options.firstHand + firstHand + i, strata)];
+            sums.hands++;
+            sums.halfUnitProfit += handProfit;
+            sums.halfUnitProfitSquared += handProfit * handProfit;
+          }
+          else if ((firstHand + i) % 2)
+          {
+            int64_t pairProfit = handProfit + (int64_t)(getShowdownProfit(batch.playBets[i - 1], batch.playerRanks[i - 1], batch.dealerRanks[i - 1]) * 2);
+            localPairSquares += pairProfit * pairProfit;
+          }
+        }
+        if (sessionStats)
+          segments[batchNumber + session - sliceFirstSession] = segment;
+        PROFILE_PHASE_END(PHASE_SCORING);
+        PROFILE_BATCH_END(batch.size);
+
+        // Publish progress in batches to keep the shared counter uncontended
+        localHands += batch.size;
+        localProgress += batch.size;
+        if (localProgress >= 2000)
+        {
+          job.currentSimulationNumber.fetch_add(localProgress, std::memory_order_relaxed);
+          localProgress = 0;
+        }
+      }
+      job.currentSimulationNumber.fetch_add(localProgress, std::memory_order_relaxed);
+      int64_t localAllocations = getThreadAllocations() - startAllocations;
+
+#pragma omp critical
+      {
+        sliceProfit += localTotalProfit;
+        sliceProfitSquared += localTotalProfitSquared;
+        slicePairSquares += localPairSquares;
+        sliceHandMoments.merge(localHandMoments);
+        for (int stratum = 0; stratum < strata; stratum++)
+        {
+          sliceStrata[stratum].hands += localStrata[stratum].hands;
+          sliceStrata[stratum].halfUnitProfit += localStrata[stratum].halfUnitProfit;
+          sliceStrata[stratum].halfUnitProfitSquared += localStrata[stratum].halfUnitProfitSquared;
+        }
+        for (int k = 0; k < configurationSumsSize; k++) sliceConfigurationSums[k] += localConfigurationSums[k];
+        sliceComplete = sliceComplete && !skippedBatches;
+        totals.allocations += localAllocations;
+        totals.outsCache.add(threadOutsCache);
+        totals.outsCache.add(startOutsCache, -1);
+        if (numaNode >= 0)
+        {
+          sliceNuma[numaNode].threads++;
+          sliceNuma[numaNode].hands += localHands;
+          sliceNuma[numaNode].threadSeconds += chrono::duration<double>(chrono::steady_clock::now() - sliceStartTime).count();
+        }
+#ifdef UTH_PROFILE
+        totals.profile.add(threadProfile);
+        totals.profile.add(startProfile, -1);
+#endif
+      }
+#pragma omp barrier
+      if (sessionStats && sliceComplete)
+      {
+        sessionSketch &localSketch = threadSketches[omp_get_thread_num()];
+#pragma omp for schedule(static)
+        for (int64_t session = sliceFirstSession; session < sliceSessionsEnd; session++)
+        {
+          sessionSegment whole = getSliceSession(session);
+          sliceSessionProfits[session - sliceFirstSession] = whole.halfUnitProfit;
+          localSketch.add(whole);
+        }
+      }
+    }
+    if (!sliceComplete)
+    {
+      totals.stop = STOP_CANCELLED;
+      break;
+    }
+    totals.hands = sliceEnd;
+    double sliceSeconds = chrono::duration<double>(chrono::steady_clock::now() - sliceStartTime).count();
+    for (size_t node = 0; node < sliceNuma.size(); node++) totals.numaNodes[node].addSlice(sliceNuma[node], sliceSeconds);
+    totals.halfUnitProfit += sliceProfit;
+    totals.halfUnitProfitSquared += sliceProfitSquared;
+    totals.halfUnitPairSquares += slicePairSquares;
+    totals.handMoments.merge(sliceHandMoments);
+    for (int k = 0; k < configurationSumsSize; k++) totals.configurationSums[k] += sliceConfigurationSums[k];
+    for (int stratum = 0; stratum < strata; stratum++)
+    {
+      totals.strata[stratum].hands += sliceStrata[stratum].hands;
+      totals.strata[stratum].halfUnitProfit += sliceStrata[stratum].halfUnitProfit;
+      totals.strata[stratum].halfUnitProfitSquared += sliceStrata[stratum].halfUnitProfitSquared;
+    }
+    if (sessionStats)
+    {
+      for (int64_t session = sliceFirstSession; session < sliceSessionsEnd; session++)
+        totals.sessionMoments.add(sliceSessionProfits[session - sliceFirstSession] / 2.0);
+      totals.partialSession = sliceEnd % handsPerSession ? getSliceSession(sliceEnd / handsPerSession) : sessionSegment{0, 0};
+    }
+    // The threads' sketches are merged into a copy for the checkpoint
+    if (isCheckpointDue(job))
+    {
+      monteCarloTotals checkpoint = totals;
+      for (int t = 0; t < (int)threadSketches.size(); t++)
+      {
+        if (t == 0)
+          checkpoint.sessions = threadSketches[0];
+        else
+          checkpoint.sessions.merge(threadSketches[t]);
+      }
+      job.onCheckpoint(checkpoint);
+    }
+
+    // Every target given has to be met
+    bool hasTarget = options.targetHalfWidth > 0 || options.targetStDevHalfWidth > 0;
+    bool edgeMet = options.targetHalfWidth <= 0 || getSampledEstimate(totals, options, z).edgeHalfWidth <= options.targetHalfWidth;
+    bool stDevMet = options.targetStDevHalfWidth <= 0;
+    if (!stDevMet && sessionStats)
+      stDevMet = totals.sessionMoments.count >= 30 && totals.sessionMoments.getStDevHalfWidth(z) <= options.targetStDevHalfWidth;
+    else if (!stDevMet)
+      stDevMet = totals.handMoments.getStDevHalfWidth(z) * sqrt((double)handsPerSession) <= options.targetStDevHalfWidth;
+    if (job.cancelled.load())
+      totals.stop = STOP_CANCELLED;
+    else if (totals.hands < sims && hasTarget && edgeMet && stDevMet)
+      totals.stop = STOP_TARGET;
+    else if (totals.hands < sims && options.timeLimitMs > 0 && chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= options.timeLimitMs)
+      totals.stop = STOP_TIME_LIMIT;
+
+    if (totals.stop == STOP_COMPLETE && isProgressDue(job))
+    {
+      sampledEstimate estimate = getSampledEstimate(totals, options, z);
+      double stDev = sqrt(estimate.handVariance * handsPerSession);
+      if (totals.sessionMoments.count > 1)
+        stDev = totals.sessionMoments.getStDev();
+      job.onProgress(progressUpdate{job.id, totals.hands, sims, getRate(totals.hands, start), true, estimate.edge, stDev, estimate.edgeHalfWidth});
+    }
+  }
+
+  if (sessionStats)
+  {
+    totals.sessions = threadSketches[0];
+    for (int t = 1; t < getPoolSize(); t++) totals.sessions.merge(threadSketches[t]);
+  }
+}
+
+// Deals hands random hands and ranks the player's and dealer's 7-card
+// hands with one evaluator backend, so the backends can be timed on the same
+// work. With other, counts the hands where the two backends disagree.
+template <class State, class OtherState = State>
+int64_t evaluateRandomHands(uint64_t seed, int64_t hands, int threads, int64_t &checksum)
+{
+  int64_t mismatches = 0;
+  int64_t localChecksum = 0;
+#pragma omp parallel num_threads(threads > 0 ? threads : omp_get_max_threads()) reduction(+ : mismatches, localChecksum)
   {
-    // Preflop
-    vector<int> knownPlayerHand;
-    knownPlayerHand.insert(knownPlayerHand.end(), playerHand.begin(), playerHand.end());
-    knownPlayerHand.push_back(flop[0]);
-    knownPlayerHand.insert(knownPlayerHand.end(), communityCards.begin() + 3, communityCards.begin() + 5);
-    vector<int> knownDealerHand;
-    knownDealerHand.insert(knownDealerHand.end(), dealerCards.begin(), dealerCards.end());
-    knownDealerHand.push_back(flop[0]);
-    knownDealerHand.insert(knownDealerHand.end(), communityCards.begin() + 3, communityCards.begin() + 5);
-    
-    bool allow4xBet = true;
-    if (excludeFishyPlays) {
-      if (playerCardValues[0] != playerCardValues[1]) {
-        int maxCard = (playerCardValues[0] > playerCardValues[1]) ? playerCardValues[0] : playerCardValues[1];
-        // Ten high or lower means max card is 8 or less (Ten=8 in internal representation, so values 0-8 are 2-through-Ten)
-        if (maxCard <= 8) {
-          allow4xBet = false; // Don't allow 4x bet for fishy play
-        }
-      }
-      // If it's a pocket pair or higher than Ten high, allow 4x bet
-    }
-    
-    if (allow4xBet && FiveCardLookupFast(knownPlayerHand.data()) > FiveCardLookupFast(knownDealerHand.data()))
+    vector<int> deck(baseDeck, baseDeck + 52);
+    int swaps[DEALT_CARDS];
+#pragma omp for schedule(static)
+    for (int64_t hand = 0; hand < hands; hand++)
     {
-      playBet = 4;
-    }
-    else {
-      vector<int> dealerPostRiverHand;
-      dealerPostRiverHand.insert(dealerPostRiverHand.end(), dealerCards.begin(), dealerCards.end());
-      dealerPostRiverHand.insert(dealerPostRiverHand.end(), communityCards.begin(), communityCards.end());
-      if (LookupHandFast(postRiverHand.data()) >= LookupHandFast(dealerPostRiverHand.data()))
+      splitMixRng rng(seed, hand);
+      dealCards(deck.data(), swaps, rng);
+      State board = State().extend(deck.data(), 5);
+      int playerRank = board.extend(deck[5], deck[6]).rank();
+      int dealerRank = board.extend(deck[7], deck[8]).rank();
+      localChecksum += playerRank - dealerRank;
+      if (!std::is_same<State, OtherState>::value)
       {
-        playBet = 2;
+        OtherState otherBoard = OtherState().extend(deck.data(), 5);
+        mismatches += playerRank != otherBoard.extend(deck[5], deck[6]).rank() || dealerRank != otherBoard.extend(deck[7], deck[8]).rank();
       }
+      undealCards(deck.data(), swaps);
     }
   }
-  return playBet;
+  checksum = localChecksum;
+  return mismatches;
 }
 
-double calculateProfitUTH(vector<int> deck, int knownDealerCards, int knownFlopCards, int knownTurnRiverCount = 0, bool excludeFishyPlays = false)
+struct evaluatorBenchmark
 {
-  // Optimized to reduce vector allocations by using manual array copying
-  int communityCards[5];
-  int playerCards[2];
-  int dealerCards[2];
-  int playerHand[7];
-  int dealerHand[7];
-  
-  // Manual array copying for better performance
-  for (int i = 0; i < 5; i++) communityCards[i] = deck[i];
-  for (int i = 0; i < 2; i++) playerCards[i] = deck[5 + i];
-  for (int i = 0; i < 2; i++) dealerCards[i] = deck[7 + i];
-  
-  // Construct hands directly
-  for (int i = 0; i < 2; i++) playerHand[i] = playerCards[i];
-  for (int i = 0; i < 5; i++) playerHand[2 + i] = communityCards[i];
-  for (int i = 0; i < 2; i++) dealerHand[i] = dealerCards[i];
-  for (int i = 0; i < 5; i++) dealerHand[2 + i] = communityCards[i];
-  
-  // Convert to vectors for getPlayBet compatibility
-  vector<int> playerCardsVec(playerCards, playerCards + 2);
-  vector<int> communityCardsVec(communityCards, communityCards + 5);
-  vector<int> dealerCardsVec(dealerCards, dealerCards + 2);
-  
-  // Use standard strategy function
-  int playBet = getPlayBet(playerCardsVec, communityCardsVec, dealerCardsVec, knownDealerCards, knownFlopCards, knownTurnRiverCount, excludeFishyPlays);
-  double profit = 0;
-  int playerHandRank = LookupHandFast(playerHand);
-  int dealerHandRank = LookupHandFast(dealerHand);
-  if (playerHandRank > dealerHandRank && playBet > 0)
+  int64_t hands;
+  int threads;
+  double tableHandsPerSecond;
+  double compactHandsPerSecond;
+  int64_t mismatches;
+  string error;
+};
+
+// Times the HandRanks table and the compact evaluator on the same random
+// hands. Runs as a job, taking its share of the pool up to threads.
+evaluatorBenchmark benchmarkEvaluators(int64_t hands, int threads)
+{
+  evaluatorBenchmark benchmark{hands, 0, 0, 0, 0, ""};
+  if (!loadHandRanks())
   {
-    // Ante bet
-    if (dealerHandRank >> 12 > 1)
+    benchmark.error = getHandRanksInfo().error;
+    return benchmark;
+  }
+  simulationJob job;
+  job.maxThreads = threads;
+  startJob(job);
+  benchmark.threads = getJobThreads(job);
+
+  int64_t tableChecksum = 0;
+  int64_t compactChecksum = 0;
+  auto start = chrono::steady_clock::now();
+  evaluateRandomHands<handState>(1, hands, benchmark.threads, tableChecksum);
+  auto tableEnd = chrono::steady_clock::now();
+  evaluateRandomHands<compactHandState>(1, hands, benchmark.threads, compactChecksum);
+  auto compactEnd = chrono::steady_clock::now();
+  int64_t checksum = 0;
+  int64_t mismatches = evaluateRandomHands<compactHandState, handState>(1, hands, benchmark.threads, checksum);
+  finishJob(job);
+
+  double tableSeconds = chrono::duration<double>(tableEnd - start).count();
+  double compactSeconds = chrono::duration<double>(compactEnd - tableEnd).count();
+  benchmark.tableHandsPerSecond = tableSeconds > 0 ? hands / tableSeconds : 0;
+  benchmark.compactHandsPerSecond = compactSeconds > 0 ? hands / compactSeconds : 0;
+  benchmark.mismatches = mismatches + (tableChecksum != compactChecksum);
+  return benchmark;
+}
+
+// Each configuration's results and every pair's edge difference from the
+// configuration sums of a Monte Carlo run. The differences are paired on the
+// same deals, so their spread is usually far below either edge's.
+void setConfigurationResults(result &simResult, const vector<uthConfiguration> &configurations, const vector<int64_t> &sums, int64_t hands, int handsPerSession, double z)
+{
+  int count = (int)configurations.size();
+  for (int a = 0; a < count; a++)
+  {
+    double profit = sums[a] / 2.0;
+    double profitSquared = sums[getProductIndex(a, a, count)] / 4.0;
+    double edge = hands > 0 ? profit / hands : 0;
+    double variance = hands > 0 ? max(profitSquared / hands - edge * edge, 0.0) : 0;
+    simResult.configurations.push_back(configurationResult{configurations[a], profit, edge, sqrt(variance * handsPerSession),
+                                                           getEdgeHalfWidth(hands, profit, profitSquared, z)});
+  }
+  for (int a = 0; a < count; a++)
+  {
+    for (int b = a + 1; b < count; b++)
     {
-      profit += 1;
+      double difference = (sums[a] - sums[b]) / 2.0;
+      double differenceSquared = (sums[getProductIndex(a, a, count)] + sums[getProductIndex(b, b, count)] - 2 * sums[getProductIndex(a, b, count)]) / 4.0;
+      simResult.edgeDifferences.push_back(edgeDifference{a, b, hands > 0 ? difference / hands : 0, getEdgeHalfWidth(hands, difference, differenceSquared, z)});
     }
-    // Play bet
-    profit += playBet;
-    // Blind bet
-    profit += getBlindBetPayTable(playerHandRank);
   }
-  else if (playerHandRank < dealerHandRank || playBet == 0)
+}
+
+// A Monte Carlo run's results from its totals. Shards merged together give
+// the same totals, and so the same results, as one run over all their hands.
+result getMonteCarloResult(const monteCarloTotals &totals, const simulationOptions &options, int handsPerSession)
+{
+  double z = getNormalQuantile(options.confidence);
+  int64_t hands = totals.hands;
+  double profit = totals.halfUnitProfit / 2.0;
+  double profitSquared = totals.halfUnitProfitSquared / 4.0;
+  double edge = hands > 0 ? profit / hands : 0.0;
+  double stDev = hands > 0 ? sqrt(profitSquared / hands - edge * edge) : 0.0;
+  // Use whole sessions' profits for the session stDev if there are any
+  if (totals.sessionMoments.count > 0)
+    stDev = totals.sessionMoments.getStDev();
+  result simResult{{}, {}, {}, profit, edge, stDev, ""};
+  simResult.hands = hands;
+  if (getThreadAllocations() >= 0 && hands > 0)
+    simResult.allocationsPerHand = (double)totals.allocations / hands;
+  simResult.stopReason = getStopReasonName(totals.stop);
+  simResult.profile = totals.profile;
+  simResult.outsCache = totals.outsCache;
+  simResult.numaNodes = totals.numaNodes;
+  // Stratified and antithetic runs weight their results by how they sampled,
+  // and give the spread of a session of independent hands
+  if (options.sampler != UNIFORM_SAMPLER)
   {
-    // Ante bet
-    if (dealerHandRank >> 12 > 1 || playBet == 0)
+    sampledEstimate estimate = getSampledEstimate(totals, options, z);
+    simResult.edge = estimate.edge;
+    simResult.profit = estimate.edge * hands;
+    simResult.stDev = sqrt(estimate.handVariance * handsPerSession);
+    simResult.edgeHalfWidth = estimate.edgeHalfWidth;
+    simResult.stDevHalfWidth = totals.handMoments.getStDevHalfWidth(z) * sqrt((double)handsPerSession);
+    return simResult;
+  }
+  simResult.edgeHalfWidth = getEdgeHalfWidth(hands, profit, profitSquared, z);
+  simResult.stDevHalfWidth = totals.sessionMoments.getStDevHalfWidth(z);
+  simResult.sessions = getSessionDistribution(totals.sessions);
+  if (!totals.configurationSums.empty())
+    setConfigurationResults(simResult, options.configurations, totals.configurationSums, hands, handsPerSession, z);
+  else if (options.configurations.size() == 1)
+    simResult.configurations.push_back(configurationResult{options.configurations[0], profit, edge, stDev, simResult.edgeHalfWidth});
+  return simResult;
+}
+
+// Sharding splits a run's hands into contiguous ranges that separate
+// processes or machines can play. Every hand is dealt from its own number's
+// stream, so the shards together deal exactly the hands of one big run. Ranges
+// start on whole sessions (whole antithetic pairs with that sampler) so no
+// session is split between shards.
+string getShardRange(int64_t sims, int handsPerSession, simulationOptions &options)
+{
+  if (options.shardIndex < 0 || options.shardIndex >= options.shardCount)
+    return "Shard index must be from 0 to the shard count - 1";
+  if (!options.hasSeed)
+    return "Sharded runs need a seed so that every shard deals from the same hands";
+  if (options.targetHalfWidth > 0 || options.targetStDevHalfWidth > 0 || options.timeLimitMs > 0)
+    return "Sharded runs play every hand, so they can't have precision targets or a time limit";
+  int64_t unit = options.sampler == UNIFORM_SAMPLER ? handsPerSession : options.sampler == ANTITHETIC_SAMPLER ? 2 : 1;
+  int64_t units = sims / unit;
+  int64_t first = units * options.shardIndex / options.shardCount * unit;
+  int64_t end = options.shardIndex == options.shardCount - 1 ? sims : units * (options.shardIndex + 1) / options.shardCount * unit;
+  options.firstHand = first;
+  options.shardHands = end - first;
+  return "";
+}
+
+// Identifies the run a shard belongs to. Only what changes the hands or how
+// they're scored goes in, so shards can run with any evaluator, batch size or
+// number of threads.
+uint64_t getRunKey(int64_t sims, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, const simulationOptions &options)
+{
+  string description = std::to_string(sims) + " " + std::to_string(handsPerSession) + " " + std::to_string(knownDealerCards) + " " +
+                       std::to_string(knownFlopCards) + " " + std::to_string(knownTurnRiverCards) + " " + std::to_string(excludeFishyPlays) + " " +
+                       std::to_string(options.seed) + " " + std::to_string(options.rng) + " " + std::to_string(options.sampler) + " " +
+                       std::to_string(options.strata) + " " + std::to_string(options.bankroll) + " " + options.strategy;
+  for (const uthConfiguration &configuration : options.configurations)
+    description += "|" + std::to_string(configuration.knownDealerCards) + " " + std::to_string(configuration.knownFlopCards) + " " +
+                   std::to_string(configuration.knownTurnRiverCards) + " " + std::to_string(configuration.excludeFishyPlays) + " " + configuration.strategy;
+  // FNV-1a
+  uint64_t key = 14695981039346656037ULL;
+  for (unsigned char c : description)
+    key = (key ^ c) * 1099511628211ULL;
+  return key;
+}
+
+// A shard's totals with what's needed to check it against other shards and
+// work out the results of merging them. Checkpoints are saved the same way.
+struct shardData
+{
+  uint64_t runKey = 0;
+  uint64_t seed = 0;
+  int64_t sims = 0; // Of the whole run
+  int handsPerSession = 1;
+  simulationOptions options;
+  monteCarloTotals totals;
+};
+
+// Shard states are a list of 8-byte little-endian values. Counts drop the
+// zeros at either end, which leaves most of a session sketch's buckets out.
+const int64_t SHARD_MAGIC = 0x4452414853485455; // "UTHSHARD"
+const int64_t SHARD_VERSION = 2;
+
+// Bump when a change to dealing, scoring or the built-in strategy changes
+// results, so results kept from older builds stop matching
+const int ENGINE_VERSION = 1;
+
+// The engine version with the state format and a hash of the built-in
+// strategy texts, reported to JavaScript as engineVersion
+string getEngineVersion()
+{
+  string description = std::to_string(SHARD_VERSION);
+  int scenarios[3][3] = {{0, 0, 0}, {1, 1, 0}, {2, 1, 2}};
+  for (auto &scenario : scenarios)
+    description += "|" + getDefaultStrategy(scenario[0], scenario[1], scenario[2]);
+  // FNV-1a
+  uint64_t key = 14695981039346656037ULL;
+  for (unsigned char c : description)
+    key = (key ^ c) * 1099511628211ULL;
+  char version[40];
+  snprintf(version, sizeof(version), "%d-%016llx", ENGINE_VERSION, (unsigned long long)key);
+  return version;
+}
+
+struct shardWriter
+{
+  vector<uint8_t> bytes;
+
+  void putInt(int64_t value)
+  {
+    uint8_t raw[8];
+    memcpy(raw, &value, 8);
+    bytes.insert(bytes.end(), raw, raw + 8);
+  }
+
+  void putDouble(double value)
+  {
+    int64_t raw;
+    memcpy(&raw, &value, 8);
+    putInt(raw);
+  }
+
+  void putCounts(const vector<int64_t> &counts)
+  {
+    size_t first = 0;
+    size_t last = counts.size();
+    while (first < last && counts[first] == 0) first++;
+    while (last > first && counts[last - 1] == 0) last--;
+    putInt(counts.size());
+    putInt(first);
+    putInt(last - first);
+    for (size_t i = first; i < last; i++) putInt(counts[i]);
+  }
+
+  void putMoments(const momentSums &moments)
+  {
+    putInt(moments.count);
+    for (int i = 0; i < 4; i++) putDouble(moments.sums[i]);
+  }
+};
+
+struct shardReader
+{
+  const uint8_t *data;
+  size_t size;
+  size_t at = 0;
+  bool ok = true;
+
+  shardReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+  int64_t getInt()
+  {
+    int64_t value = 0;
+    if (at + 8 > size)
     {
-      profit -= 1;
+      ok = false;
+      return 0;
     }
-    // Play bet
-    profit -= playBet;
-    // Blind bet
-    profit -= 1;
+    memcpy(&value, data + at, 8);
+    at += 8;
+    return value;
   }
-  return profit;
+
+  double getDouble()
+  {
+    int64_t raw = getInt();
+    double value;
+    memcpy(&value, &raw, 8);
+    return value;
+  }
+
+  vector<int64_t> getCounts()
+  {
+    int64_t length = getInt();
+    int64_t first = getInt();
+    int64_t stored = getInt();
+    if (!ok || length < 0 || length > (1 << 24) || first < 0 || stored < 0 || first + stored > length)
+    {
+      ok = false;
+      return {};
+    }
+    vector<int64_t> counts(length, 0);
+    for (int64_t i = 0; i < stored; i++) counts[first + i] = getInt();
+    return counts;
+  }
+
+  momentSums getMoments()
+  {
+    momentSums moments;
+    moments.count = getInt();
+    for (int i = 0; i < 4; i++) moments.sums[i] = getDouble();
+    return moments;
+  }
+};
+
+vector<uint8_t> serializeShard(const shardData &shard)
+{
+  const simulationOptions &options = shard.options;
+  const monteCarloTotals &totals = shard.totals;
+  shardWriter writer;
+  writer.putInt(SHARD_MAGIC);
+  writer.putInt(SHARD_VERSION);
+  writer.putInt(shard.runKey);
+  writer.putInt(shard.seed);
+  writer.putInt(shard.sims);
+  writer.putInt(shard.handsPerSession);
+  writer.putInt(options.shardIndex);
+  writer.putInt(options.shardCount);
+  writer.putInt(options.firstHand);
+  writer.putInt(options.shardHands);
+  writer.putInt(options.sampler);
+  writer.putInt(options.strata);
+  writer.putDouble(options.confidence);
+  writer.putInt(options.configurations.size());
+  for (const uthConfiguration &configuration : options.configurations)
+  {
+    writer.putInt(configuration.knownDealerCards);
+    writer.putInt(configuration.knownFlopCards);
+    writer.putInt(configuration.knownTurnRiverCards);
+    writer.putInt(configuration.excludeFishyPlays);
+  }
+  writer.putInt(totals.hands);
+  writer.putInt(totals.halfUnitProfit);
+  writer.putInt(totals.halfUnitProfitSquared);
+  writer.putInt(totals.allocations);
+  writer.putInt(totals.outsCache.lookups);
+  writer.putInt(totals.outsCache.hits);
+  writer.putInt(totals.stop);
+  writer.putInt(totals.halfUnitPairSquares);
+  writer.putMoments(totals.handMoments);
+  writer.putMoments(totals.sessionMoments);
+  writer.putInt(totals.partialSession.halfUnitProfit);
+  writer.putInt(totals.partialSession.halfUnitLow);
+  const sessionSketch &sketch = totals.sessions;
+  writer.putInt(sketch.sessions);
+  writer.putInt(sketch.losing);
+  writer.putInt(sketch.ruined);
+  writer.putInt(sketch.ruinHalfUnits);
+  writer.putInt(sketch.histogramStart);
+  writer.putInt(sketch.histogramWidth);
+  writer.putInt(sketch.below);
+  writer.putInt(sketch.above);
+  writer.putInt(sketch.evens);
+  writer.putCounts(sketch.histogram);
+  writer.putCounts(sketch.losses);
+  writer.putCounts(sketch.wins);
+  writer.putInt(totals.strata.size());
+  for (const stratumSums &sums : totals.strata)
+  {
+    writer.putInt(sums.hands);
+    writer.putInt(sums.halfUnitProfit);
+    writer.putInt(sums.halfUnitProfitSquared);
+  }
+  writer.putCounts(totals.configurationSums);
+  return writer.bytes;
 }
-struct result
+
+bool deserializeShard(const uint8_t *data, size_t size, shardData &shard)
 {
-  vector<int> playerCards;
-  vector<int> communityCards;
-  vector<int> dealerCards;
-  double profit;
-  double edge;
-  double stDev;
-  string error;
+  shardReader reader(data, size);
+  if (reader.getInt() != SHARD_MAGIC || reader.getInt() != SHARD_VERSION)
+    return false;
+  simulationOptions &options = shard.options;
+  monteCarloTotals &totals = shard.totals;
+  shard.runKey = reader.getInt();
+  shard.seed = reader.getInt();
+  shard.sims = reader.getInt();
+  shard.handsPerSession = (int)reader.getInt();
+  options.shardIndex = (int)reader.getInt();
+  options.shardCount = (int)reader.getInt();
+  options.firstHand = reader.getInt();
+  options.shardHands = reader.getInt();
+  options.sampler = (samplerType)reader.getInt();
+  options.strata = (int)reader.getInt();
+  options.confidence = reader.getDouble();
+  int64_t configurations = reader.getInt();
+  if (!reader.ok || configurations < 0 || configurations > MAX_CONFIGURATIONS)
+    return false;
+  for (int64_t c = 0; c < configurations; c++)
+  {
+    uthConfiguration configuration{0, 0, 0, false, ""};
+    configuration.knownDealerCards = (int)reader.getInt();
+    configuration.knownFlopCards = (int)reader.getInt();
+    configuration.knownTurnRiverCards = (int)reader.getInt();
+    configuration.excludeFishyPlays = reader.getInt() != 0;
+    options.configurations.push_back(configuration);
+  }
+  totals.hands = reader.getInt();
+  totals.halfUnitProfit = reader.getInt();
+  totals.halfUnitProfitSquared = reader.getInt();
+  totals.allocations = reader.getInt();
+  totals.outsCache.lookups = reader.getInt();
+  totals.outsCache.hits = reader.getInt();
+  totals.stop = (stopReason)reader.getInt();
+  totals.halfUnitPairSquares = reader.getInt();
+  totals.handMoments = reader.getMoments();
+  totals.sessionMoments = reader.getMoments();
+  totals.partialSession.halfUnitProfit = reader.getInt();
+  totals.partialSession.halfUnitLow = reader.getInt();
+  sessionSketch &sketch = totals.sessions;
+  sketch.sessions = reader.getInt();
+  sketch.losing = reader.getInt();
+  sketch.ruined = reader.getInt();
+  sketch.ruinHalfUnits = reader.getInt();
+  sketch.histogramStart = reader.getInt();
+  sketch.histogramWidth = reader.getInt();
+  sketch.below = reader.getInt();
+  sketch.above = reader.getInt();
+  sketch.evens = reader.getInt();
+  sketch.histogram = reader.getCounts();
+  sketch.losses = reader.getCounts();
+  sketch.wins = reader.getCounts();
+  int64_t strata = reader.getInt();
+  if (!reader.ok || (strata != 0 && strata != HOLE_CARD_CLASSES && strata != HOLE_CARD_COMBOS))
+    return false;
+  for (int64_t stratum = 0; stratum < strata; stratum++)
+  {
+    int64_t hands = reader.getInt();
+    int64_t halfUnitProfit = reader.getInt();
+    totals.strata.push_back(stratumSums{hands, halfUnitProfit, reader.getInt()});
+  }
+  totals.configurationSums = reader.getCounts();
+  bool sketched = sketch.histogram.size() == (size_t)SESSION_HISTOGRAM_BINS && sketch.losses.size() == (size_t)QUANTILE_BUCKETS && sketch.wins.size() == (size_t)QUANTILE_BUCKETS;
+  return reader.ok && reader.at == size && (sketch.sessions == 0 || sketched) &&
+         (totals.configurationSums.empty() || totals.configurationSums.size() == (size_t)getConfigurationSumsSize((int)configurations));
+}
+
+// Merges the states of any number of a run's shards into the result of one
+// run over all their hands
+result mergeShards(const vector<pair<const uint8_t *, size_t>> &states)
+{
+  vector<shardData> shards(states.size());
+  for (size_t i = 0; i < states.size(); i++)
+  {
+    if (!deserializeShard(states[i].first, states[i].second, shards[i]))
+      return makeErrorResult("Shard " + std::to_string(i + 1) + " isn't a valid shard state");
+  }
+  if (shards.empty())
+    return makeErrorResult("No shards to merge");
+  // Session moments are merged in the order the sessions were played
+  sort(shards.begin(), shards.end(), [](const shardData &a, const shardData &b)
+       { return a.options.shardIndex < b.options.shardIndex; });
+  shardData &merged = shards[0];
+  monteCarloTotals &totals = merged.totals;
+  for (size_t i = 1; i < shards.size(); i++)
+  {
+    const shardData &shard = shards[i];
+    const monteCarloTotals &other = shard.totals;
+    if (shard.runKey != merged.runKey || shard.options.shardCount != merged.options.shardCount)
+      return makeErrorResult("Shards come from different runs");
+    if (shard.options.shardIndex == shards[i - 1].options.shardIndex)
+      return makeErrorResult("Shard " + std::to_string(shard.options.shardIndex) + " is given more than once");
+    totals.hands += other.hands;
+    totals.halfUnitProfit += other.halfUnitProfit;
+    totals.halfUnitProfitSquared += other.halfUnitProfitSquared;
+    totals.allocations += other.allocations;
+    totals.outsCache.add(other.outsCache);
+    totals.halfUnitPairSquares += other.halfUnitPairSquares;
+    if (other.stop == STOP_CANCELLED)
+      totals.stop = STOP_CANCELLED;
+    totals.handMoments.merge(other.handMoments);
+    totals.sessionMoments.merge(other.sessionMoments);
+    if (totals.sessions.sessions == 0)
+      totals.sessions = other.sessions;
+    else if (other.sessions.sessions > 0)
+      totals.sessions.merge(other.sessions);
+    for (size_t stratum = 0; stratum < totals.strata.size() && stratum < other.strata.size(); stratum++)
+    {
+      totals.strata[stratum].hands += other.strata[stratum].hands;
+      totals.strata[stratum].halfUnitProfit += other.strata[stratum].halfUnitProfit;
+      totals.strata[stratum].halfUnitProfitSquared += other.strata[stratum].halfUnitProfitSquared;
+    }
+    for (size_t k = 0; k < totals.configurationSums.size() && k < other.configurationSums.size(); k++)
+      totals.configurationSums[k] += other.configurationSums[k];
+  }
+  result simResult = getMonteCarloResult(totals, merged.options, merged.handsPerSession);
+  simResult.seed = merged.seed;
+  simResult.shards = (int)shards.size();
+  return simResult;
+}
+
+// Checkpoint files are written whole beside the old checkpoint and then
+// renamed over it, so a crash mid-write leaves a whole checkpoint behind
+string writeCheckpoint(const string &path, const vector<uint8_t> &bytes)
+{
+  string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file)
+    return "Can't write the checkpoint file " + path;
+  bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  written = fclose(file) == 0 && written;
+  // Windows won't rename over an existing file
+  if (written && rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    remove(path.c_str());
+    written = rename(temporary.c_str(), path.c_str()) == 0;
+  }
+  return written ? "" : "Can't write the checkpoint file " + path;
+}
+
+// Reads a checkpoint, falling back to one left half-renamed on Windows
+bool readCheckpoint(const string &path, shardData &checkpoint)
+{
+  for (const string &name : {path, path + ".tmp"})
+  {
+    FILE *file = fopen(name.c_str(), "rb");
+    if (!file)
+      continue;
+    vector<uint8_t> bytes;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      bytes.insert(bytes.end(), buffer, buffer + read);
+    fclose(file);
+    checkpoint = shardData();
+    if (deserializeShard(bytes.data(), bytes.size(), checkpoint))
+      return true;
+  }
+  return false;
+}
+
+// Saves a run's checkpoints. Checkpoints taken while the run plays are
+// serialized and written on a thread of their own, so the workers carry on
+// meanwhile; one that comes due while the last is still being written is
+// skipped.
+struct checkpointWriter
+{
+  string path;
+  shardData run; // The run's details, with the totals being written
+  std::future<string> writing{};
+
+  string save(const monteCarloTotals &totals)
+  {
+    if (writing.valid())
+      writing.wait();
+    run.totals = totals;
+    return writeCheckpoint(path, serializeShard(run));
+  }
+
+  void saveInBackground(const monteCarloTotals &totals)
+  {
+    if (writing.valid() && writing.wait_for(chrono::seconds(0)) != std::future_status::ready)
+      return;
+    run.totals = totals;
+    writing = std::async(std::launch::async, [this]()
+                         { return writeCheckpoint(path, serializeShard(run)); });
+  }
 };
-result runUthSimulations(vector<int> deck, int64_t sims, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays)
+
+result runUthJob(vector<int> deck, int64_t sims, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, simulationOptions options, simulationJob &job)
 {
-  numberOfSimulations = sims;
-  atomicCurrentSimulationNumber.store(0, std::memory_order_relaxed); // Reset progress counter
-  
-  // Load the HandRanks.DAT file once and cache it
-  if (!loadHandRanks())
-    return result{{}, {}, {}, 0, 0, 0, "HandRanks.dat not found"};
-  
-  // Incremental statistics calculation to handle large simulations without memory issues
-  double totalProfit = 0.0;
-  double totalProfitSquared = 0.0;
-  int64_t simulationCount = 0;
+  job.numberOfSimulations.store(sims);
+
+  // Load the HandRanks.DAT file once and cache it. The compact evaluator
+  // doesn't need it, but exact mode always enumerates with the table.
+  bool exactMode = options.mode == EXACT && deck.size() == 0;
+  if (!options.error.empty())
+    return makeErrorResult(options.error);
+  if (options.shardCount > 0 && (exactMode || deck.size() > 0))
+    return makeErrorResult("Only Monte Carlo runs can be sharded");
+  if (!options.continueState.empty() && (exactMode || deck.size() > 0))
+    return makeErrorResult("Only Monte Carlo runs can be continued");
+
+  // The first configuration stands in for the run's own settings. Exact and
+  // single-deal runs have no sampling error to share, so they play each
+  // configuration in turn; Monte Carlo runs play the rest on the first's deals.
+  if (options.configurations.size() > MAX_CONFIGURATIONS)
+    return makeErrorResult("At most " + std::to_string(MAX_CONFIGURATIONS) + " configurations can be compared");
+  if (!options.configurations.empty() && (exactMode || deck.size() > 0))
+  {
+    simulationOptions single = options;
+    single.configurations.clear();
+    result first;
+    for (size_t c = 0; c < options.configurations.size(); c++)
+    {
+      const uthConfiguration &configuration = options.configurations[c];
+      single.strategy = configuration.strategy;
+      result played = runUthJob(deck, sims, handsPerSession, configuration.knownDealerCards, configuration.knownFlopCards, configuration.knownTurnRiverCards,
+                                configuration.excludeFishyPlays, single, job);
+      if (!played.error.empty())
+        return played;
+      if (c == 0)
+        first = played;
+      first.configurations.push_back(configurationResult{configuration, played.profit, played.edge, played.stDev, played.edgeHalfWidth});
+    }
+    for (int a = 0; a < (int)first.configurations.size(); a++)
+    {
+      for (int b = a + 1; b < (int)first.configurations.size(); b++)
+        first.edgeDifferences.push_back(edgeDifference{a, b, first.configurations[a].edge - first.configurations[b].edge, 0});
+    }
+    return first;
+  }
+  vector<uthStrategy> otherStrategies(options.configurations.size());
+  vector<configurationPlay> others;
+  if (!options.configurations.empty())
+  {
+    if (options.sampler != UNIFORM_SAMPLER)
+      return makeErrorResult("Configurations can only be compared with the uniform sampler");
+    const uthConfiguration &first = options.configurations[0];
+    knownDealerCards = first.knownDealerCards;
+    knownFlopCards = first.knownFlopCards;
+    knownTurnRiverCards = first.knownTurnRiverCards;
+    excludeFishyPlays = first.excludeFishyPlays;
+    options.strategy = first.strategy;
+    for (size_t c = 1; c < options.configurations.size(); c++)
+    {
+      const uthConfiguration &configuration = options.configurations[c];
+      const uthStrategy *otherStrategy = nullptr;
+      if (!configuration.strategy.empty())
+      {
+        string strategyError = compileStrategy(configuration.strategy, configuration.knownDealerCards, configuration.knownFlopCards, configuration.knownTurnRiverCards, otherStrategies[c]);
+        if (!strategyError.empty())
+          return makeErrorResult("Configuration " + std::to_string(c + 1) + ": " + strategyError);
+        otherStrategy = &otherStrategies[c];
+      }
+      others.push_back(configurationPlay{configuration.knownDealerCards, configuration.knownFlopCards, configuration.knownTurnRiverCards, configuration.excludeFishyPlays, otherStrategy});
+    }
+  }
+
+  // A custom strategy is compiled once for the run; null plays the built-in one
+  uthStrategy compiled;
+  const uthStrategy *strategy = nullptr;
+  if (!options.strategy.empty())
+  {
+    string strategyError = compileStrategy(options.strategy, knownDealerCards, knownFlopCards, knownTurnRiverCards, compiled);
+    if (!strategyError.empty())
+      return makeErrorResult(strategyError);
+    strategy = &compiled;
+  }
+  if ((options.evaluator == HAND_RANKS_TABLE || exactMode) && !loadHandRanks())
+    return makeErrorResult(getHandRanksInfo().error);
+
+  if (exactMode)
+    return runExactUth(handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy, job);
   
-  // For grouped statistics (limited to avoid memory issues)
-  const int maxGroupedProfits = 1000000; // Limit to 1M groups to prevent memory issues
-  vector<double> groupedProfits;
-  groupedProfits.reserve(maxGroupedProfits);
-  int currentGroupProfit = 0;
-  int simulationsInCurrentGroup = 0;
+  uint64_t seed = options.hasSeed ? options.seed : (((uint64_t)std::random_device{}() << 32) | std::random_device{}()) & ((1ULL << 53) - 1);
   
   if (deck.size() > 0)
   {
-    numberOfSimulations = 1;
-    double handProfit = calculateProfitUTH(deck, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
-    
-    totalProfit = handProfit;
-    totalProfitSquared = handProfit * handProfit;
-    simulationCount = 1;
-    groupedProfits.push_back(handProfit);
+    job.numberOfSimulations.store(1);
+    double handProfit = options.evaluator == COMPACT_EVALUATOR
+                            ? calculateProfitUTH<compactHandState>(deck, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy)
+                            : calculateProfitUTH<handState>(deck, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy);
     
     // Update final progress
-    atomicCurrentSimulationNumber.store(numberOfSimulations, std::memory_order_relaxed);
+    job.currentSimulationNumber.store(1);
+
+    vector<int> communityCards(deck.begin(), deck.begin() + 5);
+    vector<int> playerCards(deck.begin() + 5, deck.begin() + 7);
+    vector<int> dealerCards(deck.begin() + 7, deck.begin() + 9);
+    result simResult{playerCards, communityCards, dealerCards, handProfit, handProfit, 0, ""};
+    simResult.hands = 1;
+    simResult.seed = seed;
+    if (options.configurations.size() == 1)
+      simResult.configurations.push_back(configurationResult{options.configurations[0], handProfit, handProfit, 0, 0});
+    return simResult;
+  }
+
+  handsPerSession = max(handsPerSession, 1);
+  // A shard plays its share of the run's hands, numbered as in the whole run
+  if (options.shardCount > 0)
+  {
+    string shardError = getShardRange(sims, handsPerSession, options);
+    if (!shardError.empty())
+      return makeErrorResult(shardError);
   }
+  // A resumed run takes its seed from the checkpoint unless it gives one
+  shardData checkpoint;
+  bool resumed = !options.checkpointFile.empty() && options.resume && readCheckpoint(options.checkpointFile, checkpoint);
+  if (resumed && !options.hasSeed)
+    seed = checkpoint.seed;
+  // So does a continued run from its state
+  shardData earlier;
+  bool continued = !options.continueState.empty();
+  if (continued)
+  {
+    if (options.shardCount > 0 || resumed)
+      return makeErrorResult("A continued run can't be sharded or resumed");
+    if (!deserializeShard(options.continueState.data(), options.continueState.size(), earlier) || earlier.options.shardCount > 0)
+      return makeErrorResult("The state to continue isn't from a whole run");
+    if (!options.hasSeed)
+      seed = earlier.seed;
+  }
+  options.seed = seed;
+  shardData shard;
+  shard.runKey = getRunKey(sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options);
+  shard.seed = seed;
+  shard.sims = sims;
+  shard.handsPerSession = handsPerSession;
+  shard.options = options;
+  if (options.shardCount > 0)
+  {
+    sims = options.shardHands;
+    job.numberOfSimulations.store(sims);
+  }
+  monteCarloTotals &totals = shard.totals;
+  if (resumed)
+  {
+    if (checkpoint.runKey != shard.runKey || checkpoint.options.shardIndex != options.shardIndex || checkpoint.options.shardCount != options.shardCount)
+      return makeErrorResult("The checkpoint file " + options.checkpointFile + " is from a different run");
+    totals = checkpoint.totals;
+    totals.stop = STOP_COMPLETE;
+    job.currentSimulationNumber.store(totals.hands);
+  }
+  else if (continued)
+  {
+    // The earlier run must have been this one with fewer hands
+    if (earlier.totals.hands > sims || getRunKey(earlier.sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options) != earlier.runKey)
+      return makeErrorResult("The state to continue is from a different run");
+    totals = earlier.totals;
+    totals.stop = STOP_COMPLETE;
+    job.currentSimulationNumber.store(totals.hands);
+  }
+  // The first checkpoint is written straight away, which checks the file can
+  // be written before any hands are played
+  checkpointWriter checkpoints{options.checkpointFile, shard};
+  if (!options.checkpointFile.empty())
+  {
+    string checkpointError = checkpoints.save(totals);
+    if (!checkpointError.empty())
+      return makeErrorResult(checkpointError);
+    job.onCheckpoint = [&checkpoints](const monteCarloTotals &checkpointTotals)
+    { checkpoints.saveInBackground(checkpointTotals); };
+    job.checkpointIntervalMs = options.checkpointIntervalMs;
+    job.lastCheckpoint = chrono::steady_clock::now();
+  }
+  if (options.rng == PHILOX && options.evaluator == COMPACT_EVALUATOR)
+    simulateUthHands<philoxRng, compactHandState>(seed, sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, job, options, strategy, others, totals);
+  else if (options.rng == PHILOX)
+    simulateUthHands<philoxRng, handState>(seed, sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, job, options, strategy, others, totals);
+  else if (options.evaluator == COMPACT_EVALUATOR)
+    simulateUthHands<splitMixRng, compactHandState>(seed, sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, job, options, strategy, others, totals);
   else
+    simulateUthHands<splitMixRng, handState>(seed, sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, job, options, strategy, others, totals);
+  // The last checkpoint has every hand played, even if the run was cancelled
+  if (!options.checkpointFile.empty())
+  {
+    job.onCheckpoint = nullptr;
+    checkpoints.save(totals);
+  }
+  // A cancelled run reports what it played so far
+  if (totals.stop == STOP_CANCELLED && totals.hands == 0)
+    return makeErrorResult("Simulation cancelled");
+  result simResult = getMonteCarloResult(totals, options, handsPerSession);
+  simResult.seed = seed;
+  if (options.shardCount > 0)
+    simResult.shardState = serializeShard(shard);
+  else if (options.returnState)
+    simResult.runState = serializeShard(shard);
+  return simResult;
+}
+
+// Runs a simulation as a job sharing the worker pool with any other running
+// jobs. Without a job it runs as an anonymous one.
+result runUthSimulations(vector<int> deck, int64_t sims, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, simulationOptions options = simulationOptions(), simulationJob *job = nullptr)
+{
+  simulationJob anonymousJob;
+  simulationJob &runJob = job ? *job : anonymousJob;
+  runJob.maxThreads = options.threads;
+  runJob.progressIntervalMs = options.progressIntervalMs;
+  result simResult = startJob(runJob) ? runUthJob(deck, sims, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, runJob)
+                                      : makeErrorResult("Simulation cancelled");
+  finishJob(runJob);
+  runJob.finalResult = simResult;
+  runJob.state.store(runJob.cancelled.load() ? JOB_CANCELLED : JOB_DONE);
+  return simResult;
+}
+
+// A strategy parameter for the optimizer, with the values it may take as they
+// are written in the strategy text
+struct optimizerParameter
+{
+  string name;
+  vector<string> values;
+};
+
+// One value of a parameter against the value it would replace, on the search deals
+struct optimizerCandidate
+{
+  string value;
+  double difference;
+  double halfWidth;
+};
+
+struct optimizerResult
+{
+  vector<pair<string, string>> settings;         // Best value of each parameter
+  vector<vector<optimizerCandidate>> candidates; // Each parameter's last search
+  string strategy;
+  string baselineStrategy;
+  uint64_t seed;
+  int64_t hands; // Search deals
+  int rounds;
+  int evaluations;
+  // Best strategy's edge minus the baseline's, on the search deals and on
+  // validationHands fresh ones
+  double difference;
+  double halfWidth;
+  int64_t validationHands;
+  double validationEdge;
+  double validationEdgeHalfWidth;
+  double validationDifference;
+  double validationHalfWidth;
+  string error;
+};
+
+// In an optimizer template {name} or {name=default} stands for a parameter.
+// Fills in the values given, or else the defaults, and lists the placeholders
+// with their defaults.
+string fillStrategyTemplate(const string &text, const map<string, string> &values, string &filled, vector<pair<string, string>> &placeholders)
+{
+  filled.clear();
+  placeholders.clear();
+  size_t start = 0;
+  size_t open;
+  while ((open = text.find('{', start)) != string::npos)
+  {
+    size_t close = text.find('}', open);
+    if (close == string::npos)
+      return "Strategy placeholder without a closing }";
+    string placeholder = text.substr(open + 1, close - open - 1);
+    size_t equals = placeholder.find('=');
+    string name = placeholder.substr(0, equals);
+    string fallback = equals == string::npos ? "" : placeholder.substr(equals + 1);
+    if (name.empty())
+      return "Strategy placeholder without a name";
+    placeholders.push_back({name, fallback});
+    auto value = values.find(name);
+    filled += text.substr(start, open - start) + (value != values.end() ? value->second : fallback);
+    start = close + 1;
+  }
+  filled += text.substr(start);
+  return "";
+}
+
+vector<string> getRankValues(int low, int high)
+{
+  vector<string> values;
+  for (int rank = low; rank <= high; rank++)
+    values.push_back(string(1, "23456789TJQKA"[rank]));
+  return values;
+}
+
+vector<string> getCountValues(int low, int high)
+{
+  vector<string> values;
+  for (int count = low; count <= high; count++)
+    values.push_back(std::to_string(count));
+  return values;
+}
+
+// The built-in strategy for a scenario with its hand-tuned thresholds as
+// parameters, and the values to search for each
+string getOptimizerTemplate(int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, vector<optimizerParameter> &parameters)
+{
+  parameters.clear();
+  // The fishy cutoff only matters when fishy plays are excluded
+  if (excludeFishyPlays)
+    parameters.push_back({"fishy", getRankValues(5, 10)});
+  if (knownDealerCards == 1 && knownFlopCards == 1 && knownTurnRiverCards == 0)
+  {
+    parameters.push_back({"flopOuts", getCountValues(6, 18)});
+    parameters.push_back({"goodOuts", getCountValues(4, 16)});
+    parameters.push_back({"goodOrPushOuts", getCountValues(9, 21)});
+    return "preflop: knownCards fishy({fishy=T})\nflop: flopOutsBelow({flopOuts=12})\nriver: goodOuts({goodOuts=10}) goodOrPushOuts({goodOrPushOuts=15})";
+  }
+  if (knownDealerCards == 2 && knownFlopCards == 1 && knownTurnRiverCards == 2)
+    return "preflop: aheadOnKnownCards fishy({fishy=T})\nflop: aheadAtRiver";
+  parameters.push_back({"kingOffsuit", getRankValues(0, 10)});
+  parameters.push_back({"queenSuited", getRankValues(0, 9)});
+  parameters.push_back({"queenOffsuit", getRankValues(0, 9)});
+  parameters.push_back({"jackSuited", getRankValues(0, 8)});
+  parameters.push_back({"outs", getCountValues(15, 27)});
+  return "preflop: 33+ A2+ K2s+ K{kingOffsuit=5}o+ Q{queenSuited=6}s+ Q{queenOffsuit=8}o+ J{jackSuited=8}s+ JTo fishy({fishy=T})\n"
+         "flop: twoPair hiddenPair(3) fourFlush(T)\nriver: twoPair hiddenPair outsBelow({outs=21})";
+}
+
+// Plays the strategies as configurations on the same deals
+result playStrategies(const vector<string> &strategies, int64_t hands, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, const simulationOptions &options,
+                      uint64_t seed)
+{
+  simulationOptions run;
+  run.rng = options.rng;
+  run.hasSeed = true;
+  run.seed = seed;
+  run.threads = options.threads;
+  run.batchSize = options.batchSize;
+  run.evaluator = options.evaluator;
+  run.confidence = options.confidence;
+  for (const string &strategy : strategies)
+    run.configurations.push_back(uthConfiguration{knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy});
+  return runUthSimulations({}, hands, 100, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, run);
+}
+
+const edgeDifference *findEdgeDifference(const result &played, int first, int second)
+{
+  for (const edgeDifference &difference : played.edgeDifferences)
+  {
+    if (difference.first == first && difference.second == second)
+      return &difference;
+  }
+  return nullptr;
+}
+
+// Searches a strategy template's parameters one at a time for the best edge.
+// Every candidate is played on the same deals as the setting it would
+// replace, so they are compared by paired differences, and up to
+// MAX_CONFIGURATIONS share each pass over the deals. Rounds over the
+// parameters repeat until none moves or maxRounds have been played. The
+// winner is then checked against the template's defaults on fresh deals,
+// since the search deals flatter it.
+optimizerResult optimizeStrategy(string strategyTemplate, vector<optimizerParameter> parameters, int64_t hands, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards,
+                                 bool excludeFishyPlays, const simulationOptions &options, int maxRounds, int64_t validationHands)
+{
+  optimizerResult optimized{};
+  if (!options.error.empty())
+  {
+    optimized.error = options.error;
+    return optimized;
+  }
+  if (strategyTemplate.empty())
+  {
+    vector<optimizerParameter> defaults;
+    strategyTemplate = getOptimizerTemplate(knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, defaults);
+    if (parameters.empty())
+      parameters = defaults;
+  }
+  if (parameters.empty())
   {
-#pragma omp parallel
+    optimized.error = "No strategy parameters to search";
+    return optimized;
+  }
+
+  vector<pair<string, string>> placeholders;
+  optimized.error = fillStrategyTemplate(strategyTemplate, {}, optimized.baselineStrategy, placeholders);
+  if (!optimized.error.empty())
+    return optimized;
+  // Parameters start from their defaults, or else their first value
+  map<string, string> current;
+  for (const auto &placeholder : placeholders)
+    current[placeholder.first] = placeholder.second;
+  for (const optimizerParameter &parameter : parameters)
+  {
+    if (!current.count(parameter.name))
+      optimized.error = "Strategy parameter " + parameter.name + " isn't in the strategy";
+    else if (parameter.values.empty())
+      optimized.error = "Strategy parameter " + parameter.name + " has no values";
+    else if (current[parameter.name].empty())
+      current[parameter.name] = parameter.values[0];
+    if (!optimized.error.empty())
+      return optimized;
+  }
+  for (const auto &placeholder : current)
+  {
+    if (placeholder.second.empty())
     {
-      // Thread-local variables for incremental statistics
-      double localTotalProfit = 0.0;
-      double localTotalProfitSquared = 0.0;
-      int64_t localSimulationCount = 0;
-      
-      // Thread-local grouped profits (limited size)
-      const int localMaxGroups = 10000; // Local limit per thread
-      vector<double> localGroupedProfits;
-      localGroupedProfits.reserve(localMaxGroups);
-      int localCurrentGroupProfit = 0;
-      int localSimulationsInCurrentGroup = 0;
-      
-      // Thread-local RNG to avoid contention
-      std::random_device rd;
-      std::mt19937 local_rng(rd());
-      
-      // Pre-allocate deck array outside loop
-      vector<int> newDeck(52);
-      
-#pragma omp for schedule(dynamic) nowait
-      for (int64_t i = 0; i < numberOfSimulations; i++)
+      optimized.error = "Strategy parameter " + placeholder.first + " has no value";
+      return optimized;
+    }
+  }
+  // Every value has to compile, or the search would stop part of the way
+  auto fill = [&](const map<string, string> &values)
+  {
+    string filled;
+    vector<pair<string, string>> unused;
+    fillStrategyTemplate(strategyTemplate, values, filled, unused);
+    return filled;
+  };
+  for (const optimizerParameter &parameter : parameters)
+  {
+    for (const string &value : parameter.values)
+    {
+      map<string, string> values = current;
+      values[parameter.name] = value;
+      uthStrategy compiled;
+      string strategyError = compileStrategy(fill(values), knownDealerCards, knownFlopCards, knownTurnRiverCards, compiled);
+      if (!strategyError.empty())
+      {
+        optimized.error = "Strategy parameter " + parameter.name + " = " + value + ": " + strategyError;
+        return optimized;
+      }
+    }
+  }
+
+  optimized.seed = options.hasSeed ? options.seed : (((uint64_t)std::random_device{}() << 32) | std::random_device{}()) & ((1ULL << 53) - 1);
+  optimized.hands = hands;
+  optimized.candidates.resize(parameters.size());
+  for (int round = 0; round < maxRounds; round++)
+  {
+    bool moved = false;
+    for (size_t p = 0; p < parameters.size(); p++)
+    {
+      const optimizerParameter &parameter = parameters[p];
+      vector<optimizerCandidate> &candidates = optimized.candidates[p];
+      candidates.assign(1, optimizerCandidate{current[parameter.name], 0, 0});
+      vector<string> others;
+      for (const string &value : parameter.values)
+      {
+        if (value != current[parameter.name])
+          others.push_back(value);
+      }
+      // A candidate only replaces the current setting when its whole interval
+      // is above it. Ranking by that lower bound keeps the best of many noisy
+      // candidates from winning on luck alone.
+      string bestValue = current[parameter.name];
+      double bestLowerBound = 0;
+      // The current setting comes first in every pass, so passes compare alike
+      for (size_t chunk = 0; chunk < others.size(); chunk += MAX_CONFIGURATIONS - 1)
       {
-        // Only update progress periodically to reduce contention (less frequent for better performance)
-        if (i % 2000 == 0) {
-          atomicCurrentSimulationNumber.store(i + 1, std::memory_order_relaxed);
-        }
-        
-        // Optimized deck copy and shuffle
-        for (int j = 0; j < 52; j++) {
-          newDeck[j] = baseDeck[j];
+        size_t chunkEnd = min(others.size(), chunk + MAX_CONFIGURATIONS - 1);
+        vector<string> strategies = {fill(current)};
+        for (size_t c = chunk; c < chunkEnd; c++)
+        {
+          map<string, string> values = current;
+          values[parameter.name] = others[c];
+          strategies.push_back(fill(values));
         }
-        // Fisher-Yates shuffle for better performance
-        for (int j = 51; j > 0; j--) {
-          int k = local_rng() % (j + 1);
-          std::swap(newDeck[j], newDeck[k]);
+        result played = playStrategies(strategies, hands, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, optimized.seed);
+        optimized.evaluations++;
+        if (!played.error.empty())
+        {
+          optimized.error = played.error;
+          return optimized;
         }
-        
-        // Process simulation
-        double handProfit = calculateProfitUTH(newDeck, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
-        
-        // Incremental statistics calculation
-        localTotalProfit += handProfit;
-        localTotalProfitSquared += handProfit * handProfit;
-        localSimulationCount++;
-        
-        // Incremental grouped profits (limited to prevent memory issues)
-        localCurrentGroupProfit += handProfit;
-        localSimulationsInCurrentGroup++;
-        
-        if (localSimulationsInCurrentGroup >= handsPerSession) {
-          if (localGroupedProfits.size() < localMaxGroups) {
-            localGroupedProfits.push_back(localCurrentGroupProfit);
+        for (size_t c = chunk; c < chunkEnd; c++)
+        {
+          const edgeDifference *difference = findEdgeDifference(played, 0, (int)(c - chunk + 1));
+          if (!difference)
+          {
+            optimized.error = "Strategy comparison has no edge difference";
+            return optimized;
+          }
+          candidates.push_back(optimizerCandidate{others[c], -difference->difference, difference->halfWidth});
+          double lowerBound = -difference->difference - difference->halfWidth;
+          if (lowerBound > bestLowerBound)
+          {
+            bestLowerBound = lowerBound;
+            bestValue = others[c];
           }
-          localCurrentGroupProfit = 0;
-          localSimulationsInCurrentGroup = 0;
         }
       }
-      
-#pragma omp critical
+      if (bestValue != current[parameter.name])
       {
-        totalProfit += localTotalProfit;
-        totalProfitSquared += localTotalProfitSquared;
-        simulationCount += localSimulationCount;
-        
-        // Merge grouped profits (limited to prevent memory overflow)
-        for (double groupProfit : localGroupedProfits) {
-          if (groupedProfits.size() < maxGroupedProfits) {
-            groupedProfits.push_back(groupProfit);
-          }
-        }
+        current[parameter.name] = bestValue;
+        moved = true;
       }
     }
-    
-    // Update final progress
-    atomicCurrentSimulationNumber.store(numberOfSimulations, std::memory_order_relaxed);
+    optimized.rounds = round + 1;
+    if (!moved)
+      break;
   }
-  
-  // Calculate final statistics from incremental data
-  double profit = totalProfit;
-  double edge = simulationCount > 0 ? profit / simulationCount : 0.0;
-  double stDev = 0.0;
-  
-  // Calculate standard deviation using online algorithm
-  if (simulationCount > 0) {
-    double mean = edge;
-    double variance = (totalProfitSquared / simulationCount) - (mean * mean);
-    stDev = sqrt(variance);
+
+  optimized.strategy = fill(current);
+  for (const optimizerParameter &parameter : parameters)
+    optimized.settings.push_back({parameter.name, current[parameter.name]});
+  vector<string> finalists = {optimized.strategy, optimized.baselineStrategy};
+  result searched = playStrategies(finalists, hands, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, optimized.seed);
+  optimized.validationHands = validationHands;
+  result validated = validationHands > 0 ? playStrategies(finalists, validationHands, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options,
+                                                          (optimized.seed + 1) & ((1ULL << 53) - 1))
+                                         : result();
+  optimized.evaluations += 1 + (validationHands > 0);
+  if (!searched.error.empty() || !validated.error.empty())
+  {
+    optimized.error = searched.error.empty() ? validated.error : searched.error;
+    return optimized;
   }
-  
-  // Use grouped profits for more accurate stDev if available
-  if (groupedProfits.size() > 0) {
-    double groupedProfit = accumulate(groupedProfits.begin(), groupedProfits.end(), 0.0);
-    double groupedEdge = groupedProfit / groupedProfits.size();
+  const edgeDifference *searchedDifference = findEdgeDifference(searched, 0, 1);
+  const edgeDifference *validatedDifference = validationHands > 0 ? findEdgeDifference(validated, 0, 1) : nullptr;
+  if (!searchedDifference || (validationHands > 0 && !validatedDifference))
+  {
+    optimized.error = "Strategy comparison has no edge difference";
+    return optimized;
+  }
+  optimized.difference = searchedDifference->difference;
+  optimized.halfWidth = searchedDifference->halfWidth;
+  if (validationHands > 0)
+  {
+    optimized.validationEdge = validated.configurations[0].edge;
+    optimized.validationEdgeHalfWidth = validated.configurations[0].edgeHalfWidth;
+    optimized.validationDifference = validatedDifference->difference;
+    optimized.validationHalfWidth = validatedDifference->halfWidth;
+  }
+  return optimized;
+}
 
-    vector<double> diff(groupedProfits.size());
-    transform(groupedProfits.begin(), groupedProfits.end(), diff.begin(), [groupedEdge](double x)
-              { return x - groupedEdge; });
-    double variance = inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
-    stDev = sqrt(variance / groupedProfits.size());
+// Jobs started through the binding by id. Finished jobs are kept, with their
+// results, until MAX_FINISHED_JOBS newer ones have finished.
+const size_t MAX_FINISHED_JOBS = 100;
+std::mutex JOBS_mutex;
+map<int64_t, shared_ptr<simulationJob>> jobs;
+int64_t lastJobId = 0;
+
+shared_ptr<simulationJob> addJob()
+{
+  lock_guard<mutex> lock(JOBS_mutex);
+  size_t finished = 0;
+  for (auto &it : jobs)
+    finished += it.second->state.load() >= JOB_DONE;
+  for (auto it = jobs.begin(); it != jobs.end() && finished >= MAX_FINISHED_JOBS;)
+  {
+    if (it->second->state.load() >= JOB_DONE)
+    {
+      it = jobs.erase(it);
+      finished--;
+    }
+    else
+      it++;
+  }
+  shared_ptr<simulationJob> job = make_shared<simulationJob>();
+  job->id = ++lastJobId;
+  jobs[job->id] = job;
+  return job;
+}
+
+// The job with the given id, or the latest one for id 0
+shared_ptr<simulationJob> findJob(int64_t id)
+{
+  lock_guard<mutex> lock(JOBS_mutex);
+  auto it = id > 0 ? jobs.find(id) : (jobs.empty() ? jobs.end() : prev(jobs.end()));
+  return it == jobs.end() ? nullptr : it->second;
+}
+
+const char *getJobStateName(jobState state)
+{
+  switch (state)
+  {
+  case JOB_QUEUED:
+    return "queued";
+  case JOB_RUNNING:
+    return "running";
+  case JOB_CANCELLED:
+    return "cancelled";
+  default:
+    return "done";
+  }
+}
+
+#ifndef UTH_NO_NAPI
+// Adds a run's session distribution, when it has one, to a results object
+void setSessionDistribution(Env env, Object &obj, const sessionDistribution &distribution)
+{
+  if (distribution.sessions == 0)
+    return;
+  obj.Set("sessions", Number::New(env, static_cast<double>(distribution.sessions)));
+  obj.Set("losingSessionProbability", Number::New(env, distribution.losingProbability));
+  if (distribution.riskOfRuin >= 0)
+    obj.Set("riskOfRuin", Number::New(env, distribution.riskOfRuin));
+  Object percentiles = Object::New(env);
+  for (size_t i = 0; i < distribution.percentiles.size(); i++)
+    percentiles.Set(std::to_string((int)SESSION_PERCENTILES[i]), Number::New(env, distribution.percentiles[i]));
+  obj.Set("sessionPercentiles", percentiles);
+  Object histogram = Object::New(env);
+  histogram.Set("start", Number::New(env, distribution.histogramStart));
+  histogram.Set("binWidth", Number::New(env, distribution.histogramWidth));
+  Array counts = Array::New(env, distribution.histogram.size());
+  for (uint32_t i = 0; i < distribution.histogram.size(); i++)
+    counts[i] = Number::New(env, static_cast<double>(distribution.histogram[i]));
+  histogram.Set("counts", counts);
+  histogram.Set("below", Number::New(env, static_cast<double>(distribution.below)));
+  histogram.Set("above", Number::New(env, static_cast<double>(distribution.above)));
+  obj.Set("sessionHistogram", histogram);
+}
+
+// Adds a run's configurations and their edge differences, when it was given some
+void setConfigurationComparison(Env env, Object &obj, const vector<configurationResult> &played, const vector<edgeDifference> &edgeDifferences)
+{
+  if (played.empty())
+    return;
+  Array configurations = Array::New(env, played.size());
+  for (uint32_t i = 0; i < played.size(); i++)
+  {
+    const configurationResult &playedConfiguration = played[i];
+    Object configuration = Object::New(env);
+    configuration.Set("knownDealerCards", Number::New(env, playedConfiguration.configuration.knownDealerCards));
+    configuration.Set("knownFlopCards", Number::New(env, playedConfiguration.configuration.knownFlopCards));
+    configuration.Set("knownTurnRiverCards", Number::New(env, playedConfiguration.configuration.knownTurnRiverCards));
+    configuration.Set("excludeFishyPlays", Boolean::New(env, playedConfiguration.configuration.excludeFishyPlays));
+    configuration.Set("profit", Number::New(env, playedConfiguration.profit));
+    configuration.Set("edge", Number::New(env, playedConfiguration.edge));
+    configuration.Set("stDev", Number::New(env, playedConfiguration.stDev));
+    configuration.Set("edgeHalfWidth", Number::New(env, playedConfiguration.edgeHalfWidth));
+    configurations[i] = configuration;
+  }
+  obj.Set("configurations", configurations);
+  Array differences = Array::New(env, edgeDifferences.size());
+  for (uint32_t i = 0; i < edgeDifferences.size(); i++)
+  {
+    const edgeDifference &difference = edgeDifferences[i];
+    Object entry = Object::New(env);
+    entry.Set("first", Number::New(env, difference.first));
+    entry.Set("second", Number::New(env, difference.second));
+    entry.Set("difference", Number::New(env, difference.difference));
+    entry.Set("halfWidth", Number::New(env, difference.halfWidth));
+    differences[i] = entry;
+  }
+  obj.Set("edgeDifferences", differences);
+}
+
+// Adds a UTH_PROFILE build's counters and phase timings to a results object
+void setProfile(Env env, Object &obj, const profileCounts &profile, int64_t hands)
+{
+  if (!PROFILED)
+    return;
+  const int64_t *counters = profile.counters;
+  Object entry = Object::New(env);
+  entry.Set("hands", Number::New(env, static_cast<double>(hands)));
+  Object playBets = Object::New(env);
+  playBets.Set("raise4x", Number::New(env, static_cast<double>(counters[PROFILE_RAISES_4X])));
+  playBets.Set("bet2x", Number::New(env, static_cast<double>(counters[PROFILE_BETS_2X])));
+  playBets.Set("call1x", Number::New(env, static_cast<double>(counters[PROFILE_CALLS_1X])));
+  playBets.Set("fold", Number::New(env, static_cast<double>(counters[PROFILE_FOLDS])));
+  entry.Set("playBets", playBets);
+  Object badOuts = Object::New(env);
+  badOuts.Set("calls", Number::New(env, static_cast<double>(counters[PROFILE_BAD_OUTS_CALLS])));
+  badOuts.Set("earlyExits", Number::New(env, static_cast<double>(counters[PROFILE_BAD_OUTS_EARLY_EXITS])));
+  entry.Set("badOuts", badOuts);
+  Object goodOuts = Object::New(env);
+  goodOuts.Set("calls", Number::New(env, static_cast<double>(counters[PROFILE_GOOD_OUTS_CALLS])));
+  goodOuts.Set("earlyExits", Number::New(env, static_cast<double>(counters[PROFILE_GOOD_OUTS_EARLY_EXITS])));
+  entry.Set("goodOuts", goodOuts);
+  entry.Set("handRankLookupsPerHand", Number::New(env, hands > 0 ? (double)counters[PROFILE_HAND_RANK_LOOKUPS] / hands : 0));
+  entry.Set("sampledHands", Number::New(env, static_cast<double>(profile.sampledHands)));
+  Object cycles = Object::New(env);
+  const char *phases[PROFILE_PHASES] = {"shuffle", "playBet", "showdown", "scoring"};
+  for (int phase = 0; phase < PROFILE_PHASES; phase++)
+    cycles.Set(phases[phase], Number::New(env, profile.sampledHands > 0 ? (double)profile.cycles[phase] / profile.sampledHands : 0));
+  entry.Set("cyclesPerHand", cycles);
+  obj.Set("profile", entry);
+}
+
+// Adds how often the outs engine found a base's ranks in its cache to a
+// results object
+void setOutsCache(Env env, Object &obj, const outsCacheCounts &outsCache)
+{
+  Object entry = Object::New(env);
+  entry.Set("lookups", Number::New(env, static_cast<double>(outsCache.lookups)));
+  entry.Set("hits", Number::New(env, static_cast<double>(outsCache.hits)));
+  entry.Set("hitRate", Number::New(env, outsCache.lookups > 0 ? (double)outsCache.hits / outsCache.lookups : 0));
+  obj.Set("outsCache", entry);
+}
+
+void setNumaNodes(Env env, Object &obj, const vector<numaNodeCounts> &numaNodes)
+{
+  if (numaNodes.empty())
+    return;
+  Napi::Array nodes = Napi::Array::New(env, numaNodes.size());
+  for (size_t i = 0; i < numaNodes.size(); i++)
+  {
+    const numaNodeCounts &counts = numaNodes[i];
+    Object node = Object::New(env);
+    node.Set("node", Number::New(env, HR_numa.ids[i]));
+    node.Set("threads", Number::New(env, counts.threads));
+    node.Set("hands", Number::New(env, static_cast<double>(counts.hands)));
+    node.Set("handsPerSecond", Number::New(env, counts.seconds > 0 ? counts.hands / counts.seconds : 0));
+    node.Set("handsPerThreadSecond", Number::New(env, counts.threadSeconds > 0 ? counts.hands / counts.threadSeconds : 0));
+    nodes[(uint32_t)i] = node;
+  }
+  obj.Set("numaNodes", nodes);
+}
+
+void setJobStatus(Env env, Object &obj, const simulationJob &job)
+{
+  jobState state = job.state.load();
+  obj.Set("jobId", Number::New(env, static_cast<double>(job.id)));
+  obj.Set("state", String::New(env, getJobStateName(state)));
+  obj.Set("threads", Number::New(env, job.threads.load()));
+  obj.Set("currentSimulationNumber", Number::New(env, static_cast<double>(job.currentSimulationNumber.load(std::memory_order_relaxed))));
+  obj.Set("numberOfSimulations", Number::New(env, static_cast<double>(job.numberOfSimulations.load())));
+  if (state >= JOB_DONE)
+  {
+    obj.Set("profit", Number::New(env, job.finalResult.profit));
+    obj.Set("edge", Number::New(env, job.finalResult.edge));
+    obj.Set("stDev", Number::New(env, job.finalResult.stDev));
+    obj.Set("hands", Number::New(env, static_cast<double>(job.finalResult.hands)));
+    obj.Set("stopReason", String::New(env, job.finalResult.stopReason));
+    obj.Set("error", String::New(env, job.finalResult.error));
+    setSessionDistribution(env, obj, job.finalResult.sessions);
+    setConfigurationComparison(env, obj, job.finalResult.configurations, job.finalResult.edgeDifferences);
+    setProfile(env, obj, job.finalResult.profile, job.finalResult.hands);
+    setOutsCache(env, obj, job.finalResult.outsCache);
+    setNumaNodes(env, obj, job.finalResult.numaNodes);
   }
-  vector<int> communityCards;
-  vector<int> playerCards;
-  vector<int> dealerCards;
-  vector<int> playerHand;
-  vector<int> dealerHand;
-  if (deck.size())
-  {
-    communityCards.insert(communityCards.end(), deck.begin(), deck.begin() + 5);
-    playerCards.insert(playerCards.end(), deck.begin() + 5, deck.begin() + 7);
-    dealerCards.insert(dealerCards.end(), deck.begin() + 7, deck.begin() + 9);
-    playerHand.insert(playerHand.end(), playerCards.begin(), playerCards.end());
-    playerHand.insert(playerHand.end(), communityCards.begin(), communityCards.end());
-    dealerHand.insert(dealerHand.end(), dealerCards.begin(), dealerCards.end());
-    dealerHand.insert(dealerHand.end(), communityCards.begin(), communityCards.end());
-  }
-  return result{
-      playerCards,
-      communityCards,
-      dealerCards,
-      profit,
-      edge,
-      stDev,
-      ""};
 }
 
+// getSimulationStatus(jobId = latest job)
 Value GetSimulationStatus(const CallbackInfo &info)
 {
   Env env = info.Env();
   // Pre-load handranks file to improve performance on first simulation
   loadHandRanks();
   Object obj = Object::New(env);
-  // Use atomic counter for thread-safe access
-  currentSimulationNumber = atomicCurrentSimulationNumber.load(std::memory_order_relaxed);
-  Value currSimNum = Number::New(info.Env(), static_cast<double>(currentSimulationNumber));
-  Value numOfSims = Number::New(info.Env(), static_cast<double>(numberOfSimulations));
-  obj.Set("currentSimulationNumber", currSimNum);
-  obj.Set("numberOfSimulations", numOfSims);
+  shared_ptr<simulationJob> job = findJob(info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Int64Value() : 0);
+  if (job)
+    setJobStatus(env, obj, *job);
+  else
+  {
+    obj.Set("currentSimulationNumber", Number::New(env, 0));
+    obj.Set("numberOfSimulations", Number::New(env, 0));
+  }
+  {
+    lock_guard<mutex> lock(SCHEDULER_mutex);
+    obj.Set("runningJobs", Number::New(env, static_cast<double>(runningJobs.size())));
+  }
+  obj.Set("poolSize", Number::New(env, getPoolSize()));
+  handRanksInfo handRanks = getHandRanksInfo();
+  obj.Set("handRanksLoaded", Boolean::New(env, HR_loaded.load(std::memory_order_acquire)));
+  obj.Set("handRanksMapped", Boolean::New(env, handRanks.mapped));
+  obj.Set("handRanksHugePages", Boolean::New(env, handRanks.hugePages));
+  obj.Set("handRanksNumaNodes", Number::New(env, handRanks.numaNodes));
+  obj.Set("handRanksBytes", Number::New(env, static_cast<double>(handRanks.bytes)));
+  obj.Set("handRanksLoadMs", Number::New(env, handRanks.loadMs));
+  obj.Set("handRanksError", String::New(env, handRanks.error));
+  return obj;
+}
+
+// Statuses of the running, queued and recently finished jobs, oldest first
+Value ListSimulations(const CallbackInfo &info)
+{
+  Env env = info.Env();
+  vector<shared_ptr<simulationJob>> listed;
+  {
+    lock_guard<mutex> lock(JOBS_mutex);
+    for (auto &it : jobs)
+      listed.push_back(it.second);
+  }
+  Array arr = Array::New(env, listed.size());
+  for (size_t i = 0; i < listed.size(); i++)
+  {
+    Object obj = Object::New(env);
+    setJobStatus(env, obj, *listed[i]);
+    arr[(uint32_t)i] = obj;
+  }
+  return arr;
+}
+
+// cancelSimulation(jobId): stops a queued or running job. A Monte Carlo run's
+// callback then gets the statistics of the hands played so far, with
+// stopReason "cancelled"; queued and exact runs report a "Simulation
+// cancelled" error. False if there is no such job left to cancel.
+Value CancelSimulation(const CallbackInfo &info)
+{
+  Env env = info.Env();
+  shared_ptr<simulationJob> job = info.Length() > 0 && info[0].IsNumber() ? findJob(info[0].ToNumber().Int64Value()) : nullptr;
+  bool cancelled = job && job->state.load() < JOB_DONE;
+  if (cancelled)
+    cancelJob(*job);
+  return Boolean::New(env, cancelled);
+}
+
+Value VerifyDecisionTables(const CallbackInfo &info)
+{
+  Env env = info.Env();
+  int64_t checked = 0;
+  int64_t mismatches = verifyPreflopRaiseTables(checked);
+  Object obj = Object::New(env);
+  obj.Set("checked", Number::New(env, static_cast<double>(checked)));
+  obj.Set("mismatches", Number::New(env, static_cast<double>(mismatches)));
   return obj;
 }
 
+Object getProgressObject(Env env, const progressUpdate &update)
+{
+  Object obj = Object::New(env);
+  obj.Set("jobId", Number::New(env, static_cast<double>(update.jobId)));
+  obj.Set("currentSimulationNumber", Number::New(env, static_cast<double>(update.hands)));
+  obj.Set("numberOfSimulations", Number::New(env, static_cast<double>(update.numberOfSimulations)));
+  obj.Set("handsPerSecond", Number::New(env, update.handsPerSecond));
+  if (update.hasEstimate)
+  {
+    obj.Set("edge", Number::New(env, update.edge));
+    obj.Set("stDev", Number::New(env, update.stDev));
+    obj.Set("edgeHalfWidth", Number::New(env, update.edgeHalfWidth));
+  }
+  return obj;
+}
+
+const size_t PROGRESS_QUEUE_SIZE = 4;
+
 class SimulationWorker : public Napi::AsyncWorker
 {
 public:
-  SimulationWorker(Napi::Function &callback, vector<int> deck, int64_t numberOfSimulations, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays)
-      : Napi::AsyncWorker(callback), deck(deck), numberOfSimulations(numberOfSimulations), handsPerSession(handsPerSession), knownDealerCards(knownDealerCards),
-        knownFlopCards(knownFlopCards), knownTurnRiverCards(knownTurnRiverCards), excludeFishyPlays(excludeFishyPlays), profit(0), edge(0), stDev(0), error("") {}
+  SimulationWorker(Napi::Function &callback, shared_ptr<simulationJob> job, vector<int> deck, int64_t numberOfSimulations, int handsPerSession, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, simulationOptions options)
+      : Napi::AsyncWorker(callback), job(job), deck(deck), numberOfSimulations(numberOfSimulations), handsPerSession(handsPerSession), knownDealerCards(knownDealerCards),
+        knownFlopCards(knownFlopCards), knownTurnRiverCards(knownTurnRiverCards), excludeFishyPlays(excludeFishyPlays), options(options), profit(0), edge(0), stDev(0), error(""), hands(0), exact(false) {}
   ~SimulationWorker() {}
 
   // Executed inside the worker-thread.
@@ -790,7 +5378,13 @@ public:
   // should go on `this`.
   void Execute()
   {
-    result simResults = runUthSimulations(deck, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+    result simResults = runUthSimulations(deck, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, job.get());
+    // Updates already queued are still delivered before the callback
+    if (job->onProgress)
+    {
+      job->onProgress = nullptr;
+      progress.Release();
+    }
     profit = simResults.profit;
     edge = simResults.edge;
     playerCards = simResults.playerCards;
@@ -798,6 +5392,21 @@ public:
     dealerCards = simResults.dealerCards;
     error = simResults.error;
     stDev = simResults.stDev;
+    hands = simResults.hands;
+    exact = simResults.exact;
+    seed = simResults.seed;
+    allocationsPerHand = simResults.allocationsPerHand;
+    stopReason = simResults.stopReason;
+    edgeHalfWidth = simResults.edgeHalfWidth;
+    stDevHalfWidth = simResults.stDevHalfWidth;
+    sessions = simResults.sessions;
+    configurations = simResults.configurations;
+    edgeDifferences = simResults.edgeDifferences;
+    shardState = simResults.shardState;
+    runState = simResults.runState;
+    profile = simResults.profile;
+    outsCache = simResults.outsCache;
+    numaNodes = simResults.numaNodes;
   }
 
   // Executed when the async work is complete
@@ -828,6 +5437,23 @@ public:
     obj.Set("playerCards", playerCardsArr);
     obj.Set("communityCards", communityCardsArr);
     obj.Set("dealerCards", dealerCardsArr);
+    obj.Set("hands", Number::New(Env(), static_cast<double>(hands)));
+    obj.Set("exact", Boolean::New(Env(), exact));
+    obj.Set("seed", Number::New(Env(), static_cast<double>(seed)));
+    obj.Set("allocationsPerHand", Number::New(Env(), allocationsPerHand));
+    obj.Set("jobId", Number::New(Env(), static_cast<double>(job->id)));
+    obj.Set("stopReason", String::New(Env(), stopReason));
+    obj.Set("edgeHalfWidth", Number::New(Env(), edgeHalfWidth));
+    obj.Set("stDevHalfWidth", Number::New(Env(), stDevHalfWidth));
+    setSessionDistribution(Env(), obj, sessions);
+    setConfigurationComparison(Env(), obj, configurations, edgeDifferences);
+    setProfile(Env(), obj, profile, hands);
+    setOutsCache(Env(), obj, outsCache);
+    setNumaNodes(Env(), obj, numaNodes);
+    if (!shardState.empty())
+      obj.Set("shardState", Buffer<uint8_t>::Copy(Env(), shardState.data(), shardState.size()));
+    if (!runState.empty())
+      obj.Set("runState", Buffer<uint8_t>::Copy(Env(), runState.data(), runState.size()));
     Callback().Call({Napi::Number::New(Env(), profit),
                      Napi::Number::New(Env(), edge),
                      Napi::Number::New(Env(), stDev),
@@ -835,7 +5461,27 @@ public:
                      Napi::String::New(Env(), error)});
   }
 
+  // Pushes the job's progress updates to an onProgress function. The queue is
+  // short, so updates are dropped while JavaScript is busy rather than piling up.
+  void setProgress(Napi::Env env, Napi::Function onProgress)
+  {
+    progress = ThreadSafeFunction::New(env, onProgress, "uthProgress", PROGRESS_QUEUE_SIZE, 1);
+    ThreadSafeFunction queue = progress;
+    job->onProgress = [queue](const progressUpdate &update)
+    {
+      progressUpdate *queued = new progressUpdate(update);
+      if (queue.NonBlockingCall(queued, [](Napi::Env env, Napi::Function onProgress, progressUpdate *update)
+                                {
+                                  onProgress.Call({getProgressObject(env, *update)});
+                                  delete update;
+                                }) != napi_ok)
+        delete queued;
+    };
+  }
+
 private:
+  shared_ptr<simulationJob> job;
+  ThreadSafeFunction progress;
   vector<int> deck;
   vector<int> playerCards;
   vector<int> dealerCards;
@@ -846,24 +5492,185 @@ private:
   int knownFlopCards;
   int knownTurnRiverCards;
   bool excludeFishyPlays;
+  simulationOptions options;
   double profit;
   double edge;
   double stDev;
   string error;
+  int64_t hands;
+  bool exact;
+  uint64_t seed;
+  double allocationsPerHand;
+  string stopReason;
+  double edgeHalfWidth;
+  double stDevHalfWidth;
+  sessionDistribution sessions;
+  vector<configurationResult> configurations;
+  vector<edgeDifference> edgeDifferences;
+  vector<uint8_t> shardState;
+  vector<uint8_t> runState;
+  profileCounts profile;
+  outsCacheCounts outsCache;
+  vector<numaNodeCounts> numaNodes;
 };
 
-// Asynchronous access to the `Estimate()` function
+simulationOptions parseSimulationOptions(const Object &obj)
+{
+  simulationOptions options;
+  if (obj.Has("mode") && obj.Get("mode").IsString())
+  {
+    string mode = obj.Get("mode").As<String>().Utf8Value();
+    options.mode = mode == "exact" ? EXACT : MONTE_CARLO;
+  }
+  if (obj.Has("rng") && obj.Get("rng").IsString())
+  {
+    string rng = obj.Get("rng").As<String>().Utf8Value();
+    options.rng = rng == "philox" ? PHILOX : SPLITMIX;
+  }
+  // Seeds are plain numbers, so only integers up to 2^53 round-trip exactly
+  if (obj.Has("seed") && obj.Get("seed").IsNumber())
+  {
+    double seed = obj.Get("seed").As<Number>().DoubleValue();
+    if (seed >= 0 && seed <= 9007199254740992.0 && seed == floor(seed))
+    {
+      options.hasSeed = true;
+      options.seed = static_cast<uint64_t>(seed);
+    }
+    else
+      options.error = "The seed must be an integer from 0 to 2^53";
+  }
+  if (obj.Has("threads") && obj.Get("threads").IsNumber())
+  {
+    options.threads = max(0, obj.Get("threads").As<Number>().Int32Value());
+  }
+  if (obj.Has("batchSize") && obj.Get("batchSize").IsNumber())
+  {
+    options.batchSize = max(1, obj.Get("batchSize").As<Number>().Int32Value());
+  }
+  if (obj.Has("evaluator") && obj.Get("evaluator").IsString())
+  {
+    string evaluator = obj.Get("evaluator").As<String>().Utf8Value();
+    options.evaluator = evaluator == "compact" ? COMPACT_EVALUATOR : HAND_RANKS_TABLE;
+  }
+  if (obj.Has("strategy") && obj.Get("strategy").IsString())
+  {
+    options.strategy = obj.Get("strategy").As<String>().Utf8Value();
+  }
+  if (obj.Has("targetHalfWidth") && obj.Get("targetHalfWidth").IsNumber())
+  {
+    options.targetHalfWidth = obj.Get("targetHalfWidth").As<Number>().DoubleValue();
+  }
+  if (obj.Has("targetStDevHalfWidth") && obj.Get("targetStDevHalfWidth").IsNumber())
+  {
+    options.targetStDevHalfWidth = obj.Get("targetStDevHalfWidth").As<Number>().DoubleValue();
+  }
+  if (obj.Has("confidence") && obj.Get("confidence").IsNumber())
+  {
+    double confidence = obj.Get("confidence").As<Number>().DoubleValue();
+    if (confidence > 0 && confidence < 1)
+      options.confidence = confidence;
+  }
+  if (obj.Has("timeLimitMs") && obj.Get("timeLimitMs").IsNumber())
+  {
+    options.timeLimitMs = obj.Get("timeLimitMs").As<Number>().DoubleValue();
+  }
+  if (obj.Has("sampler") && obj.Get("sampler").IsString())
+  {
+    string sampler = obj.Get("sampler").As<String>().Utf8Value();
+    options.sampler = sampler == "stratified" ? STRATIFIED_SAMPLER : sampler == "antithetic" ? ANTITHETIC_SAMPLER : UNIFORM_SAMPLER;
+  }
+  if (obj.Has("strata") && obj.Get("strata").IsNumber())
+  {
+    options.strata = obj.Get("strata").As<Number>().Int32Value() == HOLE_CARD_COMBOS ? HOLE_CARD_COMBOS : HOLE_CARD_CLASSES;
+  }
+  if (obj.Has("progressIntervalMs") && obj.Get("progressIntervalMs").IsNumber())
+  {
+    options.progressIntervalMs = obj.Get("progressIntervalMs").As<Number>().DoubleValue();
+  }
+  if (obj.Has("bankroll") && obj.Get("bankroll").IsNumber())
+  {
+    options.bankroll = obj.Get("bankroll").As<Number>().DoubleValue();
+  }
+  if (obj.Has("checkpointFile") && obj.Get("checkpointFile").IsString())
+  {
+    options.checkpointFile = obj.Get("checkpointFile").As<String>().Utf8Value();
+  }
+  if (obj.Has("checkpointIntervalMs") && obj.Get("checkpointIntervalMs").IsNumber())
+  {
+    options.checkpointIntervalMs = obj.Get("checkpointIntervalMs").As<Number>().DoubleValue();
+  }
+  if (obj.Has("resume") && obj.Get("resume").IsBoolean())
+  {
+    options.resume = obj.Get("resume").As<Boolean>().Value();
+  }
+  if (obj.Has("continueState") && obj.Get("continueState").IsBuffer())
+  {
+    Buffer<uint8_t> state = obj.Get("continueState").As<Buffer<uint8_t>>();
+    options.continueState.assign(state.Data(), state.Data() + state.Length());
+  }
+  if (obj.Has("returnState") && obj.Get("returnState").IsBoolean())
+  {
+    options.returnState = obj.Get("returnState").As<Boolean>().Value();
+  }
+  if (obj.Has("shard") && obj.Get("shard").IsObject())
+  {
+    Object shard = obj.Get("shard").As<Object>();
+    options.shardIndex = shard.Get("index").ToNumber().Int32Value();
+    options.shardCount = max(1, shard.Get("count").ToNumber().Int32Value());
+  }
+  return options;
+}
+
+// Reads a list of configurations; fields left out take the run's own values
+vector<uthConfiguration> parseConfigurations(const Array &list, const uthConfiguration &defaults)
+{
+  vector<uthConfiguration> configurations;
+  for (uint32_t i = 0; i < list.Length(); i++)
+  {
+    uthConfiguration configuration = defaults;
+    if (!list.Get(i).IsObject())
+    {
+      configurations.push_back(configuration);
+      continue;
+    }
+    Object obj = list.Get(i).As<Object>();
+    if (obj.Has("knownDealerCards") && obj.Get("knownDealerCards").IsNumber())
+      configuration.knownDealerCards = obj.Get("knownDealerCards").As<Number>().Int32Value();
+    if (obj.Has("knownFlopCards") && obj.Get("knownFlopCards").IsNumber())
+      configuration.knownFlopCards = obj.Get("knownFlopCards").As<Number>().Int32Value();
+    if (obj.Has("knownTurnRiverCards") && obj.Get("knownTurnRiverCards").IsNumber())
+      configuration.knownTurnRiverCards = obj.Get("knownTurnRiverCards").As<Number>().Int32Value();
+    if (obj.Has("excludeFishyPlays") && obj.Get("excludeFishyPlays").IsBoolean())
+      configuration.excludeFishyPlays = obj.Get("excludeFishyPlays").As<Boolean>().Value();
+    if (obj.Has("strategy") && obj.Get("strategy").IsString())
+      configuration.strategy = obj.Get("strategy").As<String>().Utf8Value();
+    configurations.push_back(configuration);
+  }
+  return configurations;
+}
+
+// Queues a simulation job and returns its id for getSimulationStatus and
+// cancelSimulation; the callback gets the results
 Napi::Value RunUthSimulations(const Napi::CallbackInfo &info)
 {
   Array deckArray = info[0].As<Array>();
-  numberOfSimulations = info[1].ToNumber().Int64Value();
+  int64_t numberOfSimulations = info[1].ToNumber().Int64Value();
   int handsPerSession = info[2].ToNumber();
   int knownDealerCards = info[3].ToNumber();
   int knownFlopCards = info[4].ToNumber();
   int knownTurnRiverCards = info[5].ToNumber();
   bool excludeFishyPlays = info[6].ToBoolean();
   vector<int> deck;
-  Napi::Function callback = info[7].As<Napi::Function>();
+  // An options object may sit between excludeFishyPlays and the callback
+  Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+  simulationOptions options;
+  if (info.Length() > 8 && info[7].IsObject())
+    options = parseSimulationOptions(info[7].As<Object>());
+  if (info.Length() > 8 && info[7].IsObject() && info[7].As<Object>().Get("configurations").IsArray())
+  {
+    uthConfiguration defaults{knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options.strategy};
+    options.configurations = parseConfigurations(info[7].As<Object>().Get("configurations").As<Array>(), defaults);
+  }
   if (deckArray.Length() > 0)
   {
     for (size_t i = 0; i < deckArray.Length(); i++)
@@ -872,8 +5679,299 @@ Napi::Value RunUthSimulations(const Napi::CallbackInfo &info)
       deck.push_back(value);
     }
   }
-  SimulationWorker *piWorker = new SimulationWorker(callback, deck, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays);
+  shared_ptr<simulationJob> job = addJob();
+  job->numberOfSimulations.store(deck.size() > 0 ? 1 : numberOfSimulations);
+  SimulationWorker *piWorker = new SimulationWorker(callback, job, deck, numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options);
+  if (info.Length() > 8 && info[7].IsObject() && info[7].As<Object>().Get("onProgress").IsFunction())
+    piWorker->setProgress(info.Env(), info[7].As<Object>().Get("onProgress").As<Function>());
   piWorker->Queue();
+  return Number::New(info.Env(), static_cast<double>(job->id));
+}
+
+// Merges the shardState buffers of a sharded run's shards into the results of
+// one run over all their hands: mergeSimulationShards([shardState, ...])
+Value MergeSimulationShards(const CallbackInfo &info)
+{
+  Env env = info.Env();
+  vector<pair<const uint8_t *, size_t>> states;
+  Array buffers = info.Length() > 0 && info[0].IsArray() ? info[0].As<Array>() : Array::New(env);
+  for (uint32_t i = 0; i < buffers.Length(); i++)
+  {
+    if (!buffers.Get(i).IsBuffer())
+    {
+      states.push_back({nullptr, 0});
+      continue;
+    }
+    Buffer<uint8_t> buffer = buffers.Get(i).As<Buffer<uint8_t>>();
+    states.push_back({buffer.Data(), buffer.Length()});
+  }
+  result merged = mergeShards(states);
+  Object obj = Object::New(env);
+  obj.Set("profit", Number::New(env, merged.profit));
+  obj.Set("edge", Number::New(env, merged.edge));
+  obj.Set("stDev", Number::New(env, merged.stDev));
+  obj.Set("hands", Number::New(env, static_cast<double>(merged.hands)));
+  obj.Set("shards", Number::New(env, merged.shards));
+  obj.Set("seed", Number::New(env, static_cast<double>(merged.seed)));
+  obj.Set("stopReason", String::New(env, merged.stopReason));
+  obj.Set("edgeHalfWidth", Number::New(env, merged.edgeHalfWidth));
+  obj.Set("stDevHalfWidth", Number::New(env, merged.stDevHalfWidth));
+  obj.Set("error", String::New(env, merged.error));
+  setSessionDistribution(env, obj, merged.sessions);
+  setConfigurationComparison(env, obj, merged.configurations, merged.edgeDifferences);
+  setOutsCache(env, obj, merged.outsCache);
+  return obj;
+}
+
+class HandEvWorker : public Napi::AsyncWorker
+{
+public:
+  HandEvWorker(Napi::Function &callback, vector<int> cards, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, int street, string strategyText, int threads)
+      : Napi::AsyncWorker(callback), cards(cards), knownDealerCards(knownDealerCards), knownFlopCards(knownFlopCards), knownTurnRiverCards(knownTurnRiverCards),
+        excludeFishyPlays(excludeFishyPlays), street(street), strategyText(strategyText), threads(threads), evs{0, 0, {0, 0}, 0, 0, 0, ""} {}
+  ~HandEvWorker() {}
+
+  void Execute()
+  {
+    uthStrategy compiled;
+    const uthStrategy *strategy = nullptr;
+    if (!strategyText.empty())
+    {
+      evs.error = compileStrategy(strategyText, knownDealerCards, knownFlopCards, knownTurnRiverCards, compiled);
+      if (!evs.error.empty())
+        return;
+      strategy = &compiled;
+    }
+    if (!loadHandRanks())
+    {
+      evs.error = getHandRanksInfo().error;
+      return;
+    }
+    evs = getHandEvs(cards.data(), knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, strategy, street, threads);
+  }
+
+  void OnOK()
+  {
+    Napi::HandleScope scope(Env());
+    Object obj = Object::New(Env());
+    obj.Set("street", String::New(Env(), STREET_NAMES[evs.street]));
+    obj.Set("deals", Number::New(Env(), static_cast<double>(evs.deals)));
+    Object actions = Object::New(Env());
+    for (int action = 0; action < 2; action++)
+      actions.Set(STREET_ACTIONS[evs.street][action], Number::New(Env(), evs.evs[action]));
+    obj.Set("evs", actions);
+    obj.Set("strategyAction", String::New(Env(), STREET_ACTIONS[evs.street][evs.strategyAction]));
+    obj.Set("bestAction", String::New(Env(), STREET_ACTIONS[evs.street][evs.bestAction]));
+    obj.Set("milliseconds", Number::New(Env(), evs.milliseconds));
+    obj.Set("error", String::New(Env(), evs.error));
+    Callback().Call({obj});
+  }
+
+private:
+  vector<int> cards;
+  int knownDealerCards;
+  int knownFlopCards;
+  int knownTurnRiverCards;
+  bool excludeFishyPlays;
+  int street;
+  string strategyText;
+  int threads;
+  handEvs evs;
+};
+
+// Exact EV of each action on one street of a partly known hand:
+// getHandEvs(cards, knownDealerCards, knownFlopCards, knownTurnRiverCards,
+// excludeFishyPlays, [{street, strategy, threads}], callback). Cards are in
+// deck order (community, player, dealer) with 0 for an unknown card.
+Value GetHandEvs(const CallbackInfo &info)
+{
+  Array cardsArray = info[0].IsArray() ? info[0].As<Array>() : Array::New(info.Env());
+  vector<int> cards(DEALT_CARDS, 0);
+  for (uint32_t i = 0; i < cardsArray.Length() && i < (uint32_t)DEALT_CARDS; i++)
+    cards[i] = cardsArray.Get(i).ToNumber().Int32Value();
+  int knownDealerCards = info[1].ToNumber();
+  int knownFlopCards = info[2].ToNumber();
+  int knownTurnRiverCards = info[3].ToNumber();
+  bool excludeFishyPlays = info[4].ToBoolean();
+  Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+  int street = -1;
+  string strategy;
+  int threads = 0;
+  if (info.Length() > 6 && info[5].IsObject())
+  {
+    Object obj = info[5].As<Object>();
+    if (obj.Has("street") && obj.Get("street").IsString())
+    {
+      string name = obj.Get("street").As<String>().Utf8Value();
+      for (int s = PREFLOP_STREET; s <= RIVER_STREET; s++)
+      {
+        if (name == STREET_NAMES[s])
+          street = s;
+      }
+    }
+    if (obj.Has("strategy") && obj.Get("strategy").IsString())
+      strategy = obj.Get("strategy").As<String>().Utf8Value();
+    if (obj.Has("threads") && obj.Get("threads").IsNumber())
+      threads = obj.Get("threads").As<Number>().Int32Value();
+  }
+  HandEvWorker *worker = new HandEvWorker(callback, cards, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, street, strategy, threads);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+class OptimizeWorker : public Napi::AsyncWorker
+{
+public:
+  OptimizeWorker(Napi::Function &callback, int64_t hands, int knownDealerCards, int knownFlopCards, int knownTurnRiverCards, bool excludeFishyPlays, simulationOptions options,
+                 vector<optimizerParameter> parameters, int rounds, int64_t validationHands)
+      : Napi::AsyncWorker(callback), hands(hands), knownDealerCards(knownDealerCards), knownFlopCards(knownFlopCards), knownTurnRiverCards(knownTurnRiverCards),
+        excludeFishyPlays(excludeFishyPlays), options(options), parameters(parameters), rounds(rounds), validationHands(validationHands), optimized() {}
+  ~OptimizeWorker() {}
+
+  void Execute()
+  {
+    optimized = optimizeStrategy(options.strategy, parameters, hands, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, rounds, validationHands);
+  }
+
+  void OnOK()
+  {
+    Napi::HandleScope scope(Env());
+    Object obj = Object::New(Env());
+    obj.Set("strategy", String::New(Env(), optimized.strategy));
+    obj.Set("baselineStrategy", String::New(Env(), optimized.baselineStrategy));
+    obj.Set("seed", Number::New(Env(), static_cast<double>(optimized.seed)));
+    obj.Set("hands", Number::New(Env(), static_cast<double>(optimized.hands)));
+    obj.Set("rounds", Number::New(Env(), optimized.rounds));
+    obj.Set("evaluations", Number::New(Env(), optimized.evaluations));
+    Array settings = Array::New(Env(), optimized.settings.size());
+    for (size_t p = 0; p < optimized.settings.size(); p++)
+    {
+      Object setting = Object::New(Env());
+      setting.Set("name", String::New(Env(), optimized.settings[p].first));
+      setting.Set("value", String::New(Env(), optimized.settings[p].second));
+      Array candidates = Array::New(Env(), optimized.candidates[p].size());
+      for (size_t c = 0; c < optimized.candidates[p].size(); c++)
+      {
+        Object candidate = Object::New(Env());
+        candidate.Set("value", String::New(Env(), optimized.candidates[p][c].value));
+        candidate.Set("difference", Number::New(Env(), optimized.candidates[p][c].difference));
+        candidate.Set("halfWidth", Number::New(Env(), optimized.candidates[p][c].halfWidth));
+        candidates[c] = candidate;
+      }
+      setting.Set("candidates", candidates);
+      settings[p] = setting;
+    }
+    obj.Set("parameters", settings);
+    obj.Set("difference", Number::New(Env(), optimized.difference));
+    obj.Set("halfWidth", Number::New(Env(), optimized.halfWidth));
+    Object validation = Object::New(Env());
+    validation.Set("hands", Number::New(Env(), static_cast<double>(optimized.validationHands)));
+    validation.Set("edge", Number::New(Env(), optimized.validationEdge));
+    validation.Set("edgeHalfWidth", Number::New(Env(), optimized.validationEdgeHalfWidth));
+    validation.Set("difference", Number::New(Env(), optimized.validationDifference));
+    validation.Set("halfWidth", Number::New(Env(), optimized.validationHalfWidth));
+    obj.Set("validation", validation);
+    obj.Set("error", String::New(Env(), optimized.error));
+    Callback().Call({obj});
+  }
+
+private:
+  int64_t hands;
+  int knownDealerCards;
+  int knownFlopCards;
+  int knownTurnRiverCards;
+  bool excludeFishyPlays;
+  simulationOptions options;
+  vector<optimizerParameter> parameters;
+  int rounds;
+  int64_t validationHands;
+  optimizerResult optimized;
+};
+
+// Searches strategy parameters on common deals: optimizeStrategy(numberOfSimulations,
+// knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays,
+// [{strategy, parameters, rounds, validationHands, ...}], callback). The
+// options also take the seed, rng, threads, evaluator and confidence of a run.
+Value OptimizeStrategy(const CallbackInfo &info)
+{
+  int64_t hands = info[0].ToNumber().Int64Value();
+  int knownDealerCards = info[1].ToNumber();
+  int knownFlopCards = info[2].ToNumber();
+  int knownTurnRiverCards = info[3].ToNumber();
+  bool excludeFishyPlays = info[4].ToBoolean();
+  Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+  simulationOptions options;
+  vector<optimizerParameter> parameters;
+  int rounds = 5;
+  int64_t validationHands = hands;
+  if (info.Length() > 6 && info[5].IsObject())
+  {
+    Object obj = info[5].As<Object>();
+    options = parseSimulationOptions(obj);
+    // {name: [value, ...]}, numbers or strings as written in the strategy
+    if (obj.Has("parameters") && obj.Get("parameters").IsObject())
+    {
+      Object values = obj.Get("parameters").As<Object>();
+      Array names = values.GetPropertyNames();
+      for (uint32_t i = 0; i < names.Length(); i++)
+      {
+        optimizerParameter parameter{names.Get(i).ToString().Utf8Value(), {}};
+        Value list = values.Get(names.Get(i));
+        for (uint32_t v = 0; list.IsArray() && v < list.As<Array>().Length(); v++)
+          parameter.values.push_back(list.As<Array>().Get(v).ToString().Utf8Value());
+        parameters.push_back(parameter);
+      }
+    }
+    if (obj.Has("rounds") && obj.Get("rounds").IsNumber())
+      rounds = max(1, obj.Get("rounds").As<Number>().Int32Value());
+    if (obj.Has("validationHands") && obj.Get("validationHands").IsNumber())
+      validationHands = obj.Get("validationHands").As<Number>().Int64Value();
+  }
+  OptimizeWorker *worker = new OptimizeWorker(callback, hands, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, options, parameters, rounds, validationHands);
+  worker->Queue();
+  return info.Env().Undefined();
+}
+
+class BenchmarkWorker : public Napi::AsyncWorker
+{
+public:
+  BenchmarkWorker(Napi::Function &callback, int64_t hands, int threads)
+      : Napi::AsyncWorker(callback), hands(hands), threads(threads), benchmark{hands, 0, 0, 0, 0, ""} {}
+  ~BenchmarkWorker() {}
+
+  void Execute()
+  {
+    benchmark = benchmarkEvaluators(hands, threads);
+  }
+
+  void OnOK()
+  {
+    Napi::HandleScope scope(Env());
+    Object obj = Object::New(Env());
+    obj.Set("hands", Number::New(Env(), static_cast<double>(benchmark.hands)));
+    obj.Set("threads", Number::New(Env(), benchmark.threads));
+    obj.Set("tableHandsPerSecond", Number::New(Env(), benchmark.tableHandsPerSecond));
+    obj.Set("compactHandsPerSecond", Number::New(Env(), benchmark.compactHandsPerSecond));
+    obj.Set("mismatches", Number::New(Env(), static_cast<double>(benchmark.mismatches)));
+    obj.Set("error", String::New(Env(), benchmark.error));
+    Callback().Call({obj});
+  }
+
+private:
+  int64_t hands;
+  int threads;
+  evaluatorBenchmark benchmark;
+};
+
+// Times the HandRanks table and the compact evaluator on the same random
+// hands: benchmarkEvaluators([hands = 10000000, [threads = every core]], callback)
+Value BenchmarkEvaluators(const CallbackInfo &info)
+{
+  int64_t hands = info.Length() > 1 && info[0].IsNumber() ? info[0].ToNumber().Int64Value() : 10000000;
+  int threads = info.Length() > 2 && info[1].IsNumber() ? info[1].ToNumber().Int32Value() : 0;
+  Napi::Function callback = info[info.Length() - 1].As<Napi::Function>();
+  BenchmarkWorker *worker = new BenchmarkWorker(callback, hands, threads);
+  worker->Queue();
   return info.Env().Undefined();
 }
 
@@ -881,7 +5979,16 @@ Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
   exports.Set("getSimulationStatus", Function::New(env, GetSimulationStatus));
   exports.Set("runUthSimulations", Function::New(env, RunUthSimulations));
+  exports.Set("listSimulations", Function::New(env, ListSimulations));
+  exports.Set("cancelSimulation", Function::New(env, CancelSimulation));
+  exports.Set("mergeSimulationShards", Function::New(env, MergeSimulationShards));
+  exports.Set("verifyDecisionTables", Function::New(env, VerifyDecisionTables));
+  exports.Set("benchmarkEvaluators", Function::New(env, BenchmarkEvaluators));
+  exports.Set("getHandEvs", Function::New(env, GetHandEvs));
+  exports.Set("optimizeStrategy", Function::New(env, OptimizeStrategy));
+  exports.Set("engineVersion", String::New(env, getEngineVersion()));
   return exports;
 }
 
 NODE_API_MODULE(addon, Init)
+#endif
@@ -1,4 +1,36 @@
 {
+  "variables": {
+    "count_allocations%": 0,
+    "profile%": 0,
+    "pgo%": ""
+  },
+  "target_defaults": {
+    "conditions": [
+      ["OS=='linux'", {
+        "cflags_cc": ["-fopenmp", "-flto=auto"],
+        "ldflags": ["-fopenmp", "-flto=auto"]
+      }],
+      ["OS=='linux' and pgo=='generate'", {
+        "cflags_cc": ["-fprofile-generate=<(module_root_dir)/build/pgo"],
+        "ldflags": ["-fprofile-generate=<(module_root_dir)/build/pgo"]
+      }],
+      ["OS=='linux' and pgo=='use'", {
+        "cflags_cc": ["-fprofile-use=<(module_root_dir)/build/pgo", "-fprofile-correction", "-Wno-missing-profile"]
+      }],
+      ["OS=='win' and pgo=='generate'", {
+        "msvs_settings": {
+          "VCCLCompilerTool": { "AdditionalOptions": ["/GL"] },
+          "VCLinkerTool": { "AdditionalOptions": ["/GENPROFILE:PGD=<(module_root_dir)/build/pgo/<(_target_name).pgd"] }
+        }
+      }],
+      ["OS=='win' and pgo=='use'", {
+        "msvs_settings": {
+          "VCCLCompilerTool": { "AdditionalOptions": ["/GL"] },
+          "VCLinkerTool": { "AdditionalOptions": ["/USEPROFILE:PGD=<(module_root_dir)/build/pgo/<(_target_name).pgd"] }
+        }
+      }]
+    ]
+  },
   "targets": [
     {
       "target_name": "native",
@@ -22,7 +54,33 @@
         'AdditionalOptions' : ['/openmp', '/O2']
       },
     },
-      "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"]
+      "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"],
+      "conditions": [
+        ["count_allocations==1", { "defines": ["UTH_COUNT_ALLOCATIONS"] }],
+        ["profile==1", { "defines": ["UTH_PROFILE"] }]
+      ]
+    },
+    {
+      "target_name": "benchmark",
+      "type": "executable",
+      "sources": [
+        "benchmark.cpp"
+      ],
+      "win_delay_load_hook": "false",
+    'cflags!': [ '-fno-exceptions' ],
+    'cflags_cc!': [ '-fno-exceptions' ],
+    'xcode_settings': {
+      'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+      'CLANG_CXX_LIBRARY': 'libc++',
+     'MACOSX_DEPLOYMENT_TARGET': '10.7',
+    },
+    'msvs_settings': {
+      'VCCLCompilerTool': {
+        'ExceptionHandling': 1,
+        'AdditionalOptions' : ['/openmp', '/O2']
+      },
+    },
+      "defines": ["UTH_NO_NAPI"]
     }
   ]
 }
@@ -0,0 +1,101 @@
+const crypto = require("crypto");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+const binding = require("bindings")("native");
+
+// Monte Carlo results are kept here with the state needed to carry their runs
+// on, so asking for a run again returns straight away and asking for more hands
+// only plays the extra ones
+const RESULT_CACHE_DIRECTORY = process.env.RESULT_CACHE_DIRECTORY || path.join(os.tmpdir(), "poker-calc-results");
+// Changes with the engine version, the state format or the built-in
+// strategies, so results kept by older builds stop matching
+const CACHE_VERSION = binding.engineVersion;
+
+// Identifies a run by everything that changes its hands, how they're scored
+// or the confidence of its intervals, but not its length. Runs that stop early or keep their own checkpoints
+// aren't cached, and get no key.
+function getCacheKey(numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options) {
+  if (!Number.isInteger(numberOfSimulations) || numberOfSimulations <= 0 || options.mode === "exact" ||
+      options.checkpointFile !== undefined || options.shard !== undefined ||
+      options.targetHalfWidth || options.targetStDevHalfWidth || options.timeLimitMs) {
+    return null;
+  }
+  // Unseeded runs share the stream of whichever seed the first one picked
+  const run = [CACHE_VERSION, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy,
+    options.seed !== undefined ? options.seed : "any", options.rng, options.sampler, options.strata,
+    options.bankroll, options.confidence, options.strategy, options.configurations];
+  return crypto.createHash("sha256").update(JSON.stringify(run)).digest("hex");
+}
+
+function getEntryFile(key) {
+  return path.join(RESULT_CACHE_DIRECTORY, key + ".json");
+}
+
+function readEntry(key) {
+  try {
+    return JSON.parse(fs.readFileSync(getEntryFile(key), "utf8"));
+  } catch (error) {
+    return null;
+  }
+}
+
+// Looks a run up before it's played. A hit comes back with its result; a run
+// for more hands than were kept has its options set to carry the kept run on.
+function lookUpRun(args) {
+  const [numberOfSimulations, , , , , , options] = args;
+  const key = getCacheKey(...args);
+  if (!key) return { key, status: "bypass", reusedHands: 0 };
+  options.returnState = true;
+  const entry = readEntry(key);
+  if (entry && entry.hands === numberOfSimulations) {
+    return { key, status: "hit", reusedHands: entry.hands, result: entry.result };
+  }
+  if (entry && entry.hands < numberOfSimulations) {
+    options.continueState = Buffer.from(entry.state, "base64");
+    return { key, status: "topUp", reusedHands: entry.hands };
+  }
+  return { key, status: "miss", reusedHands: 0 };
+}
+
+// Keeps a finished run unless the cache already has a longer one. The entry is
+// written to a temporary file and renamed, so readers never see half of one.
+function storeRun(key, result, state) {
+  const existing = readEntry(key);
+  if (existing && existing.hands >= result.hands) return;
+  try {
+    fs.mkdirSync(RESULT_CACHE_DIRECTORY, { recursive: true });
+    const file = getEntryFile(key);
+    const temporary = `${file}.${process.pid}.tmp`;
+    fs.writeFileSync(temporary, JSON.stringify({ version: CACHE_VERSION, hands: result.hands, result, state: state.toString("base64") }));
+    fs.renameSync(temporary, file);
+  } catch (error) {
+    // A run that can't be cached still has its result
+  }
+}
+
+function getCacheInfo(lookup, numberOfSimulations) {
+  return {
+    status: lookup.status,
+    reusedHands: lookup.reusedHands,
+    reuseFraction: numberOfSimulations > 0 ? lookup.reusedHands / numberOfSimulations : 0
+  };
+}
+
+// The response for a cache hit
+function getCachedRun(lookup, numberOfSimulations) {
+  return { ...lookup.result, cache: getCacheInfo(lookup, numberOfSimulations) };
+}
+
+// Gives the response for a played run, with how much of it came from the
+// cache, and keeps the run when it played to the end
+function finishRun(lookup, numberOfSimulations, profit, edge, stDev, details) {
+  const { runState, ...rest } = details;
+  const result = { profit, edge, stDev, ...rest };
+  if (lookup.key && runState && result.stopReason === "complete" && result.hands === numberOfSimulations) {
+    storeRun(lookup.key, result, runState);
+  }
+  return { ...result, cache: getCacheInfo(lookup, numberOfSimulations) };
+}
+
+module.exports = { lookUpRun, getCachedRun, finishRun };
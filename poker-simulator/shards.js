@@ -0,0 +1,121 @@
+// Plays a Monte Carlo run as shards in worker processes and merges them into
+// the results of one run. The run is described by a JSON file with the same
+// fields as a /api/runUthSimulations request body.
+//
+//   node shards.js run.json [--shards 8] [--processes 4]
+//       plays every shard here and prints the merged results
+//   node shards.js run.json --shard 3/8 --out shard3.bin
+//       plays one shard, for spreading a run over several machines
+//   node shards.js --merge shard0.bin shard1.bin ...
+//       merges shard files and prints the results
+//
+// Every shard of a run needs the same seed. A run played here picks one and
+// prints it to stderr if it doesn't give one.
+const { fork } = require("child_process");
+const crypto = require("crypto");
+const fs = require("fs");
+const os = require("os");
+const binding = require("bindings")("native");
+const { getSimulationArguments } = require("./simulationArguments");
+
+function playShard(body, index, count, threads) {
+  // Each shard keeps its own checkpoint
+  if (body.checkpoint !== undefined) body = { ...body, checkpoint: `${body.checkpoint}-shard${index}` };
+  const [numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options] = getSimulationArguments(body);
+  options.shard = { index, count };
+  if (threads) options.threads = threads;
+  return new Promise((resolve, reject) => {
+    binding.runUthSimulations([], numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options, (profit, edge, stDev, details, error) => {
+      if (error) reject(new Error(`Shard ${index}: ${error}`));
+      else resolve(details.shardState);
+    });
+  });
+}
+
+// Plays count shards in up to processes worker processes, splitting the cores
+// between them, and resolves with the shards' states in shard order
+function playShards(body, count, processes) {
+  processes = Math.max(1, Math.min(processes, count));
+  const threads = Math.max(1, Math.floor(os.cpus().length / processes));
+  const states = new Array(count);
+  let next = 0;
+  const runWorker = () => new Promise((resolve, reject) => {
+    const worker = fork(__filename, ["--worker"]);
+    const sendNext = () => {
+      if (next >= count) {
+        worker.disconnect();
+        resolve();
+        return;
+      }
+      worker.send({ body, index: next++, count, threads });
+    };
+    worker.on("message", (message) => {
+      if (message.error) {
+        worker.kill();
+        reject(new Error(message.error));
+        return;
+      }
+      states[message.index] = Buffer.from(message.state, "base64");
+      sendNext();
+    });
+    worker.on("exit", (code) => {
+      if (code) reject(new Error(`A shard worker exited with code ${code}`));
+    });
+    sendNext();
+  });
+  return Promise.all(Array.from({ length: processes }, runWorker)).then(() => states);
+}
+
+function mergeShards(states) {
+  const merged = binding.mergeSimulationShards(states);
+  if (merged.error) throw new Error(merged.error);
+  return merged;
+}
+
+// Plays a run as count shards on this machine and resolves with the merged results
+function runShardedSimulations(body, count = 4, processes = os.cpus().length) {
+  return playShards(body, count, processes).then(mergeShards);
+}
+
+function getFlag(args, name) {
+  const at = args.indexOf(name);
+  return at >= 0 ? args[at + 1] : undefined;
+}
+
+function main(args) {
+  if (args[0] === "--worker") {
+    process.on("message", ({ body, index, count, threads }) => {
+      playShard(body, index, count, threads).then(
+        (state) => process.send({ index, state: state.toString("base64") }),
+        (error) => process.send({ index, error: error.message }));
+    });
+    return Promise.resolve();
+  }
+  if (args[0] === "--merge") {
+    const results = mergeShards(args.slice(1).map((file) => fs.readFileSync(file)));
+    console.log(JSON.stringify(results, null, 2));
+    return Promise.resolve();
+  }
+  const body = JSON.parse(fs.readFileSync(args[0], "utf8"));
+  const shard = getFlag(args, "--shard");
+  if (shard) {
+    const [index, count] = shard.split("/").map(Number);
+    return playShard(body, index, count).then((state) => fs.writeFileSync(getFlag(args, "--out") || `shard${index}.bin`, state));
+  }
+  if (body.seed === undefined) {
+    body.seed = crypto.randomInt(2 ** 48 - 1);
+    console.error(`Using seed ${body.seed}`);
+  }
+  const count = Number(getFlag(args, "--shards") || 4);
+  const processes = Number(getFlag(args, "--processes") || os.cpus().length);
+  return runShardedSimulations(body, count, processes).then((results) => console.log(JSON.stringify(results, null, 2)));
+}
+
+if (require.main === module) {
+  main(process.argv.slice(2)).catch((error) => {
+    console.error(error.message);
+    process.exit(1);
+  });
+}
+
+module.exports = { runShardedSimulations };
@@ -0,0 +1,54 @@
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+// Requests name their checkpoints rather than giving a path; the files all
+// live in this directory
+const CHECKPOINT_DIRECTORY = process.env.CHECKPOINT_DIRECTORY || path.join(os.tmpdir(), "poker-calc-checkpoints");
+
+function getCheckpointFile(name) {
+  if (!/^[\w-]{1,100}$/.test(name)) {
+    throw new Error("Checkpoint names can only have letters, digits, - and _");
+  }
+  fs.mkdirSync(CHECKPOINT_DIRECTORY, { recursive: true });
+  return path.join(CHECKPOINT_DIRECTORY, name + ".checkpoint");
+}
+
+// Reads runUthSimulations arguments from a request body, for the plain and
+// streaming routes and for sharded runs
+function getSimulationArguments(body) {
+  const { numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays, mode, seed, rng, threads, batchSize, evaluator, strategy, targetHalfWidth, targetStDevHalfWidth, confidence, timeLimitMs, sampler, strata, progressIntervalMs, bankroll, configurations, checkpoint, checkpointIntervalMs, resume } = body;
+  // Use default values if not provided
+  const dealerCards = knownDealerCards !== undefined ? knownDealerCards : 0;
+  const flopCards = knownFlopCards !== undefined ? knownFlopCards : 0;
+  const turnRiverCards = knownTurnRiverCards !== undefined ? knownTurnRiverCards : 0;
+  const excludeFishy = excludeFishyPlays !== undefined ? excludeFishyPlays : false;
+  // "exact" enumerates every deal instead of sampling numberOfSimulations hands
+  const options = { mode: mode !== undefined ? mode : "montecarlo" };
+  // Passing back the seed from an earlier response repeats that run exactly
+  if (seed !== undefined) options.seed = seed;
+  if (rng !== undefined) options.rng = rng;
+  if (threads !== undefined) options.threads = threads;
+  if (batchSize !== undefined) options.batchSize = batchSize;
+  if (evaluator !== undefined) options.evaluator = evaluator;
+  if (strategy !== undefined) options.strategy = strategy;
+  // With a precision target or time limit numberOfSimulations is only the most hands to play
+  if (targetHalfWidth !== undefined) options.targetHalfWidth = targetHalfWidth;
+  if (targetStDevHalfWidth !== undefined) options.targetStDevHalfWidth = targetStDevHalfWidth;
+  if (confidence !== undefined) options.confidence = confidence;
+  if (timeLimitMs !== undefined) options.timeLimitMs = timeLimitMs;
+  if (sampler !== undefined) options.sampler = sampler;
+  if (strata !== undefined) options.strata = strata;
+  if (progressIntervalMs !== undefined) options.progressIntervalMs = progressIntervalMs;
+  if (bankroll !== undefined) options.bankroll = bankroll;
+  // Scenarios or strategies to compare on the same deals
+  if (configurations !== undefined) options.configurations = configurations;
+  // A run with a checkpoint saves its progress, and with resume carries on
+  // from where a run with the same arguments left off
+  if (checkpoint !== undefined) options.checkpointFile = getCheckpointFile(checkpoint);
+  if (checkpointIntervalMs !== undefined) options.checkpointIntervalMs = checkpointIntervalMs;
+  if (resume !== undefined) options.resume = resume;
+  return [numberOfSimulations, handsPerSession, dealerCards, flopCards, turnRiverCards, excludeFishy, options];
+}
+
+module.exports = { getSimulationArguments };
@@ -1,22 +1,97 @@
 import { cardNotationToInt } from '../../src/app/utils/cardConversion';
-import { SimulationResults } from '../../src/app/models/simulationResults';
+import { SimulationResults, SimulationStatus } from '../../src/app/models/simulationResults';
 const bindings = require('bindings');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+type SimulationCallback = (
+  profit: number,
+  edge: number,
+  stDev: number,
+  cards: { communityCards: number[], playerCards: number[], dealerCards: number[], hands?: number, exact?: boolean, seed?: number, allocationsPerHand?: number, jobId?: number,
+    stopReason?: string, edgeHalfWidth?: number, stDevHalfWidth?: number,
+    sessions?: number, losingSessionProbability?: number, riskOfRuin?: number, sessionPercentiles?: { [percentile: string]: number },
+    sessionHistogram?: { start: number, binWidth: number, counts: number[], below: number, above: number },
+    configurations?: { knownDealerCards: number, knownFlopCards: number, knownTurnRiverCards: number, excludeFishyPlays: boolean,
+      profit: number, edge: number, stDev: number, edgeHalfWidth: number }[],
+    edgeDifferences?: { first: number, second: number, difference: number, halfWidth: number }[], shardState?: Buffer, runState?: Buffer,
+    outsCache?: { lookups: number, hits: number, hitRate: number },
+    numaNodes?: { node: number, threads: number, hands: number, handsPerSecond: number, handsPerThreadSecond: number }[],
+    profile?: { hands: number, playBets: { raise4x: number, bet2x: number, call1x: number, fold: number },
+      badOuts: { calls: number, earlyExits: number }, goodOuts: { calls: number, earlyExits: number },
+      handRankLookupsPerHand: number, sampledHands: number, cyclesPerHand: { [phase: string]: number } } },
+  error?: string
+) => void;
+type EvaluatorBenchmark = {
+  hands: number, threads: number, tableHandsPerSecond: number, compactHandsPerSecond: number, mismatches: number, error: string
+};
 const binding: {
-  runUthSimulations: (
+  runUthSimulations: {
+    (
+      cards: number[],
+      numberOfSimulations: number,
+      handsPerSession: number,
+      knownDealerCards: number,
+      knownFlopCards: number,
+      knownTurnRiverCards: number,
+      excludeFishyPlays: boolean,
+      callback: SimulationCallback
+    ): number,
+    (
+      cards: number[],
+      numberOfSimulations: number,
+      handsPerSession: number,
+      knownDealerCards: number,
+      knownFlopCards: number,
+      knownTurnRiverCards: number,
+      excludeFishyPlays: boolean,
+      options: { mode?: string, seed?: number, rng?: string, threads?: number, batchSize?: number, evaluator?: string, strategy?: string,
+        targetHalfWidth?: number, targetStDevHalfWidth?: number, confidence?: number, timeLimitMs?: number,
+        sampler?: string, strata?: number,
+        onProgress?: (status: SimulationStatus) => void, progressIntervalMs?: number, bankroll?: number,
+        configurations?: { knownDealerCards?: number, knownFlopCards?: number, knownTurnRiverCards?: number, excludeFishyPlays?: boolean, strategy?: string }[],
+        shard?: { index: number, count: number }, checkpointFile?: string, checkpointIntervalMs?: number, resume?: boolean,
+        continueState?: Buffer, returnState?: boolean },
+      callback: SimulationCallback
+    ): number
+  },
+  getSimulationStatus: (jobId?: number) => SimulationStatus & { profit?: number, edge?: number, stDev?: number, hands?: number, error?: string },
+  listSimulations: () => SimulationStatus[],
+  cancelSimulation: (jobId: number) => boolean,
+  mergeSimulationShards: (shardStates: Buffer[]) => {
+    profit: number, edge: number, stDev: number, hands: number, shards: number, seed: number, stopReason: string,
+    edgeHalfWidth: number, stDevHalfWidth: number, sessions: number, losingSessionProbability: number, error: string
+  },
+  verifyDecisionTables: () => { checked: number, mismatches: number },
+  benchmarkEvaluators: {
+    (callback: (benchmark: EvaluatorBenchmark) => void): void,
+    (hands: number, callback: (benchmark: EvaluatorBenchmark) => void): void,
+    (hands: number, threads: number, callback: (benchmark: EvaluatorBenchmark) => void): void
+  },
+  getHandEvs: (
     cards: number[],
+    knownDealerCards: number,
+    knownFlopCards: number,
+    knownTurnRiverCards: number,
+    excludeFishyPlays: boolean,
+    options: { street?: string, strategy?: string, threads?: number },
+    callback: (evs: { street: string, deals: number, evs: { [action: string]: number }, strategyAction: string, bestAction: string,
+      milliseconds: number, error: string }) => void
+  ) => void,
+  engineVersion: string,
+  optimizeStrategy: (
     numberOfSimulations: number,
-    handsPerSession: number,
     knownDealerCards: number,
     knownFlopCards: number,
     knownTurnRiverCards: number,
     excludeFishyPlays: boolean,
-    callback: (
-      profit: number,
-      edge: number,
-      stDev: number,
-      cards: { communityCards: number[], playerCards: number[], dealerCards: number[] }
-    ) => void
-  ) => Promise<SimulationResults>
+    options: { strategy?: string, parameters?: { [name: string]: (number | string)[] }, rounds?: number, validationHands?: number, seed?: number, threads?: number,
+      confidence?: number },
+    callback: (optimized: { strategy: string, baselineStrategy: string, seed: number, hands: number, rounds: number, evaluations: number,
+      parameters: { name: string, value: string, candidates: { value: string, difference: number, halfWidth: number }[] }[],
+      difference: number, halfWidth: number,
+      validation: { hands: number, edge: number, edgeHalfWidth: number, difference: number, halfWidth: number }, error: string }) => void
+  ) => void
 } = bindings('native');
 const cnToInt = (cards: string[]) => cards.map(card => cardNotationToInt(card));
 
@@ -2177,4 +2252,569 @@ describe('One flop card and one dealer card known', () => {
       );
     });
   });
-});
\ No newline at end of file
+});
+
+describe('HandRanks table', () => {
+  it('should report the table as loaded and shared after a simulation', (done) => {
+    binding.runUthSimulations(
+      [1, 2, 3, 4, 5, 6, 7, 8, 9], 0, 1, 0, 0, 0, false,
+      () => {
+        const status = binding.getSimulationStatus();
+        expect(status.handRanksLoaded).toBe(true);
+        expect(status.handRanksMapped || status.handRanksHugePages).toBe(true);
+        expect(status.handRanksBytes).toEqual(32487834 * 4);
+        expect(status.handRanksLoadMs).toBeGreaterThanOrEqual(0);
+        expect(status.handRanksError).toEqual('');
+        done();
+      }
+    );
+  });
+});
+
+describe('Preflop decision tables', () => {
+  it('should match the reference 4x rules for every deal of the cards they depend on', () => {
+    const { checked, mismatches } = binding.verifyDecisionTables();
+    expect(checked).toEqual(52 * 51 + 52 * 51 * 50 * 49 * 2);
+    expect(mismatches).toEqual(0);
+  });
+});
+
+describe('Exact mode', () => {
+  // Every deal is enumerated, about ten minutes on one core even with a
+  // strategy this short, so the spec gets a long timeout
+  const strategy = 'preflop: 22+';
+
+  it('should cover every deal and agree with a long Monte Carlo run', (done) => {
+    binding.runUthSimulations([], 0, 100, 0, 0, 0, false, { mode: 'exact', strategy }, (profit, edge, stDev, exact) => {
+      expect(exact.exact).toBe(true);
+      // Flops, turn and river pairs, player hands and dealer hands in either order
+      expect(exact.hands).toEqual(22100 * 1176 * 1081 * 1980);
+      binding.runUthSimulations([], 4000000, 100, 0, 0, 0, false, { seed: 11, strategy }, (sampledProfit, sampledEdge, sampledStDev, sampled) => {
+        expect(Math.abs(sampledEdge - edge)).toBeLessThan(sampled.edgeHalfWidth!);
+        done();
+      });
+    });
+  }, 60 * 60 * 1000);
+});
+
+describe('Seeded simulations', () => {
+  it('should give identical results for the same seed at any thread count', (done) => {
+    binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 12345, threads: 1 }, (profit, edge, stDev, cards) => {
+      expect(cards.seed).toEqual(12345);
+      expect(cards.hands).toEqual(20000);
+      binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 12345, threads: 4 }, (profit4, edge4, stDev4) => {
+        expect({ profit: profit4, edge: edge4, stDev: stDev4 }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+
+  it('should not allocate per hand when allocations are counted', (done) => {
+    binding.runUthSimulations([], 20000, 100, 1, 1, 0, false, { seed: 1 }, (profit, edge, stDev, cards) => {
+      // -1 unless the binding was built with count_allocations=1
+      expect([-1, 0]).toContain(cards.allocationsPerHand as number);
+      done();
+    });
+  });
+
+  it('should give identical results for the same seed at any batch size', (done) => {
+    binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 99, batchSize: 1 }, (profit, edge, stDev) => {
+      binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 99, batchSize: 256 }, (profit256, edge256, stDev256) => {
+        expect({ profit: profit256, edge: edge256, stDev: stDev256 }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+
+  it('should reject seeds that are not integers from 0 to 2^53', (done) => {
+    binding.runUthSimulations([], 1000, 100, 0, 0, 0, false, { seed: -1 }, (profit, edge, stDev, cards, error) => {
+      expect(error).toEqual('The seed must be an integer from 0 to 2^53');
+      binding.runUthSimulations([], 1000, 100, 0, 0, 0, false, { seed: 1.5 }, (profit2, edge2, stDev2, cards2, error2) => {
+        expect(error2).toEqual('The seed must be an integer from 0 to 2^53');
+        done();
+      });
+    });
+  });
+
+  it('should give identical results for the same seed with the philox generator', (done) => {
+    binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 7, rng: 'philox', threads: 1 }, (profit, edge, stDev) => {
+      binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 7, rng: 'philox', threads: 3 }, (profit3, edge3, stDev3) => {
+        expect({ profit: profit3, edge: edge3, stDev: stDev3 }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+});
+
+describe('Compact evaluator', () => {
+  it('should give the same results as the HandRanks table', (done) => {
+    binding.runUthSimulations([], 20000, 100, 1, 1, 0, false, { seed: 3 }, (profit, edge, stDev) => {
+      binding.runUthSimulations([], 20000, 100, 1, 1, 0, false, { seed: 3, evaluator: 'compact' }, (compactProfit, compactEdge, compactStDev) => {
+        expect({ profit: compactProfit, edge: compactEdge, stDev: compactStDev }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+
+  it('should rank random hands the same as the HandRanks table', (done) => {
+    binding.benchmarkEvaluators(100000, 100000, (benchmark) => {
+      expect(benchmark.error).toEqual('');
+      expect(benchmark.mismatches).toEqual(0);
+      expect(benchmark.threads).toBeLessThanOrEqual(os.cpus().length);
+      expect(benchmark.tableHandsPerSecond).toBeGreaterThan(0);
+      expect(benchmark.compactHandsPerSecond).toBeGreaterThan(0);
+      done();
+    });
+  });
+});
+
+describe('Loadable strategies', () => {
+  const defaultStrategy = 'preflop: 33+ A2+ K2s+ K5o+ Q6s+ Q8o+ J8s+ JTo\n' +
+    'flop: twoPair hiddenPair(3) fourFlush(T)\n' +
+    'river: twoPair hiddenPair outsBelow(21)';
+
+  it('should give the same results as the built-in strategy when given its definition', (done) => {
+    binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 11 }, (profit, edge, stDev) => {
+      binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 11, strategy: defaultStrategy }, (loadedProfit, loadedEdge, loadedStDev) => {
+        expect({ profit: loadedProfit, edge: loadedEdge, stDev: loadedStDev }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+
+  it('should report an error for an unknown rule', (done) => {
+    binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { strategy: 'river: goodOuts(10)' }, (profit, edge, stDev, cards, error) => {
+      expect(error).toContain('goodOuts(10)');
+      done();
+    });
+  });
+});
+
+describe('Simulation jobs', () => {
+  it('should keep progress and results separate for concurrent jobs', (done) => {
+    let finished = 0;
+    const firstId = binding.runUthSimulations([], 20000, 100, 0, 0, 0, false, { seed: 21 }, (profit, edge, stDev, cards) => {
+      expect(cards.jobId).toEqual(firstId);
+      const status = binding.getSimulationStatus(firstId);
+      expect(status.state).toEqual('done');
+      expect(status.currentSimulationNumber).toEqual(20000);
+      expect(status.numberOfSimulations).toEqual(20000);
+      expect(status.edge).toEqual(edge);
+      if (++finished === 2) done();
+    });
+    const secondId = binding.runUthSimulations([], 30000, 100, 1, 1, 0, false, { seed: 21 }, (profit, edge, stDev, cards) => {
+      expect(cards.jobId).toEqual(secondId);
+      const status = binding.getSimulationStatus(secondId);
+      expect(status.currentSimulationNumber).toEqual(30000);
+      expect(status.numberOfSimulations).toEqual(30000);
+      if (++finished === 2) done();
+    });
+    expect(secondId).not.toEqual(firstId);
+    expect(binding.listSimulations().map(job => job.jobId)).toEqual(jasmine.arrayContaining([firstId, secondId]));
+  });
+
+  it('should stop a cancelled job and report the hands played so far', (done) => {
+    const jobId = binding.runUthSimulations([], 1000000000, 100, 0, 0, 0, false, { seed: 1 }, (profit, edge, stDev, cards, error) => {
+      expect(error).toEqual('');
+      expect(cards.stopReason).toEqual('cancelled');
+      expect(cards.hands as number).toBeLessThan(1000000000);
+      expect(binding.getSimulationStatus(jobId).state).toEqual('cancelled');
+      expect(binding.cancelSimulation(jobId)).toBe(false);
+      done();
+    });
+    setTimeout(() => expect(binding.cancelSimulation(jobId)).toBe(true), 200);
+  });
+});
+
+describe('Precision targets', () => {
+  it('should stop at the same hand at any thread count once the target is met', (done) => {
+    binding.runUthSimulations([], 100000000, 100, 0, 0, 0, false, { seed: 4, targetHalfWidth: 0.05, threads: 1 }, (profit, edge, stDev, cards) => {
+      expect(cards.stopReason).toEqual('target');
+      expect(cards.edgeHalfWidth as number).toBeLessThanOrEqual(0.05);
+      expect((cards.hands as number) % 65536).toEqual(0);
+      binding.runUthSimulations([], 100000000, 100, 0, 0, 0, false, { seed: 4, targetHalfWidth: 0.05, threads: 4 }, (profit4, edge4, stDev4, cards4) => {
+        expect({ profit: profit4, edge: edge4, stDev: stDev4, hands: cards4.hands }).toEqual({ profit, edge, stDev, hands: cards.hands });
+        done();
+      });
+    });
+  });
+
+  it('should stop at the same hand when slices cover several checkpoints', (done) => {
+    const options = { seed: 4, targetHalfWidth: 0.025, threads: 1 };
+    binding.runUthSimulations([], 100000000, 100, 0, 0, 0, false, options, (profit, edge, stDev, cards) => {
+      expect(cards.stopReason).toEqual('target');
+      expect((cards.hands as number) / 65536 % 2).toEqual(1);
+      // Either would play 131072 hands in each slice
+      binding.runUthSimulations([], 100000000, 100, 0, 0, 0, false, { ...options, threads: 32 }, (profit32, edge32, stDev32, cards32) => {
+        binding.runUthSimulations([], 100000000, 100, 0, 0, 0, false, { ...options, batchSize: 2048 }, (profitBatch, edgeBatch, stDevBatch, cardsBatch) => {
+          expect({ edge: edge32, hands: cards32.hands }).toEqual({ edge, hands: cards.hands });
+          expect({ edge: edgeBatch, hands: cardsBatch.hands }).toEqual({ edge, hands: cards.hands });
+          done();
+        });
+      });
+    });
+  });
+
+  it('should stop once the time limit has passed', (done) => {
+    binding.runUthSimulations([], 100000000000, 100, 0, 0, 0, false, { timeLimitMs: 300 }, (profit, edge, stDev, cards) => {
+      expect(cards.stopReason).toEqual('timeLimit');
+      expect(cards.hands as number).toBeGreaterThan(0);
+      done();
+    });
+  });
+});
+
+describe('Variance reduction samplers', () => {
+  it('should give the same stratified results at any thread count', (done) => {
+    binding.runUthSimulations([], 50000, 100, 1, 1, 0, false, { seed: 8, sampler: 'stratified', threads: 1 }, (profit, edge, stDev, cards) => {
+      expect(cards.hands).toEqual(50000);
+      expect(Math.abs(edge - 0.2)).toBeLessThan(4 * (cards.edgeHalfWidth as number));
+      binding.runUthSimulations([], 50000, 100, 1, 1, 0, false, { seed: 8, sampler: 'stratified', threads: 3 }, (profit3, edge3, stDev3) => {
+        expect({ profit: profit3, edge: edge3, stDev: stDev3 }).toEqual({ profit, edge, stDev });
+        done();
+      });
+    });
+  });
+
+  it('should pin down the edge more tightly with antithetic deals', (done) => {
+    binding.runUthSimulations([], 200000, 100, 0, 0, 0, false, { seed: 8 }, (profit, edge, stDev, cards) => {
+      binding.runUthSimulations([], 200000, 100, 0, 0, 0, false, { seed: 8, sampler: 'antithetic' }, (antitheticProfit, antitheticEdge, antitheticStDev, antitheticCards) => {
+        expect(antitheticCards.edgeHalfWidth as number).toBeLessThan(cards.edgeHalfWidth as number);
+        expect(Math.abs(antitheticStDev - stDev)).toBeLessThan(0.2 * stDev);
+        done();
+      });
+    });
+  });
+});
+
+describe('Live progress', () => {
+  it('should push progress with running estimates before the result', (done) => {
+    const updates: SimulationStatus[] = [];
+    binding.runUthSimulations([], 2000000, 100, 0, 0, 0, false, { seed: 9, progressIntervalMs: 0, onProgress: (status) => updates.push(status) }, (profit, edge, stDev, cards) => {
+      expect(updates.length).toBeGreaterThan(0);
+      updates.forEach((status, i) => {
+        expect(status.jobId).toEqual(cards.jobId);
+        expect(status.numberOfSimulations).toEqual(2000000);
+        expect(status.currentSimulationNumber).toBeLessThanOrEqual(2000000);
+        expect(status.edge).toBeDefined();
+        if (i > 0) {
+          expect(status.currentSimulationNumber).toBeGreaterThan(updates[i - 1].currentSimulationNumber);
+        }
+      });
+      done();
+    });
+  });
+});
+
+describe('Session distribution', () => {
+  it('should sketch every session the same way at any thread count', (done) => {
+    binding.runUthSimulations([], 300000, 7, 0, 0, 0, false, { seed: 5, bankroll: 30, threads: 1 }, (profit, edge, stDev, cards) => {
+      expect(cards.sessions).toEqual(42857);
+      const counts = cards.sessionHistogram!.counts.reduce((sum, count) => sum + count, 0);
+      expect(counts + cards.sessionHistogram!.below + cards.sessionHistogram!.above).toEqual(42857);
+      expect(cards.losingSessionProbability).toBeGreaterThan(0.4);
+      expect(cards.losingSessionProbability).toBeLessThan(0.6);
+      expect(cards.riskOfRuin).toBeGreaterThan(0);
+      expect(cards.sessionPercentiles!['5']).toBeLessThan(cards.sessionPercentiles!['50']);
+      expect(cards.sessionPercentiles!['50']).toBeLessThan(cards.sessionPercentiles!['95']);
+      binding.runUthSimulations([], 300000, 7, 0, 0, 0, false, { seed: 5, bankroll: 30, threads: 3, batchSize: 5 }, (profit3, edge3, stDev3, cards3) => {
+        expect({ stDev: stDev3, losing: cards3.losingSessionProbability, ruin: cards3.riskOfRuin, percentiles: cards3.sessionPercentiles, histogram: cards3.sessionHistogram })
+          .toEqual({ stDev, losing: cards.losingSessionProbability, ruin: cards.riskOfRuin, percentiles: cards.sessionPercentiles, histogram: cards.sessionHistogram });
+        done();
+      });
+    });
+  });
+});
+
+describe('Configuration comparisons', () => {
+  it('should give each configuration the edge of its own run on the same deals', (done) => {
+    const configurations = [{}, { knownDealerCards: 1, knownFlopCards: 1 }, { knownDealerCards: 1, knownFlopCards: 1, excludeFishyPlays: true }];
+    binding.runUthSimulations([], 200000, 100, 0, 0, 0, false, { seed: 5, configurations }, (profit, edge, stDev, cards) => {
+      expect(cards.configurations!.length).toEqual(3);
+      expect(cards.configurations![0].edge).toEqual(edge);
+      expect(cards.edgeDifferences!.map(d => [d.first, d.second])).toEqual([[0, 1], [0, 2], [1, 2]]);
+      // Paired on the same deals, the difference is pinned down far more tightly than either edge
+      const difference = cards.edgeDifferences![2];
+      expect(difference.difference).toBeCloseTo(cards.configurations![1].edge - cards.configurations![2].edge, 10);
+      expect(difference.halfWidth).toBeLessThan(cards.configurations![1].edgeHalfWidth / 2);
+      binding.runUthSimulations([], 200000, 100, 1, 1, 0, true, { seed: 5 }, (profit2, edge2) => {
+        expect(cards.configurations![2].edge).toEqual(edge2);
+        done();
+      });
+    });
+  });
+});
+
+describe('Sharded runs', () => {
+  it('should merge shards into the results of one run over all their hands', (done) => {
+    const states: Buffer[] = [];
+    const playShard = (index: number) => {
+      binding.runUthSimulations([], 300001, 100, 0, 0, 0, false, { seed: 5, shard: { index, count: 3 } }, (profit, edge, stDev, cards) => {
+        states[index] = cards.shardState!;
+        if (index < 2) {
+          playShard(index + 1);
+          return;
+        }
+        binding.runUthSimulations([], 300001, 100, 0, 0, 0, false, { seed: 5 }, (profit2, edge2, stDev2, whole) => {
+          // Shards can be merged in any order
+          const merged = binding.mergeSimulationShards([states[2], states[0], states[1]]);
+          expect(merged.error).toEqual('');
+          expect(merged.hands).toEqual(300001);
+          expect(merged.edge).toEqual(edge2);
+          expect(merged.stDev).toEqual(stDev2);
+          expect(merged.losingSessionProbability).toEqual(whole.losingSessionProbability!);
+          expect(binding.mergeSimulationShards([states[0], states[0]]).error).not.toEqual('');
+          done();
+        });
+      });
+    };
+    playShard(0);
+  });
+});
+
+describe('Checkpoints', () => {
+  it('should resume an interrupted run to the results of an uninterrupted one', (done) => {
+    const checkpointFile = path.join(os.tmpdir(), 'uth-spec.checkpoint');
+    binding.runUthSimulations([], 3000000, 100, 0, 0, 0, false, { seed: 5 }, (profit, edge, stDev, whole) => {
+      // The time limit stands in for a restart part of the way through
+      binding.runUthSimulations([], 3000000, 100, 0, 0, 0, false, { seed: 5, checkpointFile, timeLimitMs: 1, threads: 1 }, (profit2, edge2, stDev2, first) => {
+        expect(first.stopReason).toEqual('timeLimit');
+        expect(first.hands!).toBeLessThan(3000000);
+        binding.runUthSimulations([], 3000000, 100, 0, 0, 0, false, { seed: 5, checkpointFile, resume: true }, (profit3, edge3, stDev3, resumed) => {
+          expect(resumed.hands).toEqual(3000000);
+          expect(edge3).toEqual(edge);
+          expect(stDev3).toEqual(stDev);
+          expect(resumed.sessionHistogram!.counts).toEqual(whole.sessionHistogram!.counts);
+          done();
+        });
+      });
+    });
+  });
+});
+
+describe('Continued runs', () => {
+  it('should carry a shorter run on to the results of the longer one', (done) => {
+    binding.runUthSimulations([], 2000000, 100, 1, 1, 0, false, { seed: 5 }, (profit, edge, stDev, whole) => {
+      binding.runUthSimulations([], 700000, 100, 1, 1, 0, false, { seed: 5, returnState: true }, (profit2, edge2, stDev2, first) => {
+        expect(first.runState!.length).toBeGreaterThan(0);
+        binding.runUthSimulations([], 2000000, 100, 1, 1, 0, false, { continueState: first.runState, threads: 1 }, (profit3, edge3, stDev3, continued) => {
+          expect(continued.hands).toEqual(2000000);
+          expect(continued.seed).toEqual(5);
+          expect(edge3).toEqual(edge);
+          expect(stDev3).toEqual(stDev);
+          expect(continued.sessionHistogram!.counts).toEqual(whole.sessionHistogram!.counts);
+          done();
+        });
+      });
+    });
+  });
+
+  it('should refuse the state of a different run', (done) => {
+    binding.runUthSimulations([], 10000, 100, 0, 0, 0, false, { seed: 5, returnState: true }, (profit, edge, stDev, first) => {
+      binding.runUthSimulations([], 20000, 100, 2, 1, 0, false, { continueState: first.runState }, (profit2, edge2, stDev2, continued, error) => {
+        expect(error).toEqual('The state to continue is from a different run');
+        done();
+      });
+    });
+  });
+});
+
+describe('Result cache', () => {
+  process.env.RESULT_CACHE_DIRECTORY = path.join(os.tmpdir(), `uth-spec-results-${process.pid}`);
+  const { lookUpRun, getCachedRun, finishRun } = require('../resultCache');
+  const { getSimulationArguments } = require('../simulationArguments');
+  const getArguments = (body: object) => getSimulationArguments({ handsPerSession: 100, knownDealerCards: 1, knownFlopCards: 1, seed: 5, ...body });
+  // Stands in for a run's details, with a state to keep
+  const played = (hands: number) => ({ hands, stopReason: 'complete', runState: Buffer.from([hands % 256]) });
+
+  beforeEach(() => {
+    fs.rmSync(process.env.RESULT_CACHE_DIRECTORY, { recursive: true, force: true });
+  });
+
+  it('should miss, then hit a run with the same hands', () => {
+    const args = getArguments({ numberOfSimulations: 1000 });
+    const lookup = lookUpRun(args);
+    expect(lookup.status).toEqual('miss');
+    expect(args[6].returnState).toBe(true);
+    const missed = finishRun(lookup, 1000, 10, 0.01, 5, played(1000));
+    expect(missed.cache).toEqual({ status: 'miss', reusedHands: 0, reuseFraction: 0 });
+    expect(missed.runState).toBeUndefined();
+
+    const hit = lookUpRun(getArguments({ numberOfSimulations: 1000 }));
+    expect(hit.status).toEqual('hit');
+    expect(getCachedRun(hit, 1000)).toEqual({ profit: 10, edge: 0.01, stDev: 5, hands: 1000, stopReason: 'complete', cache: { status: 'hit', reusedHands: 1000, reuseFraction: 1 } });
+  });
+
+  it('should top up a longer run and keep it', () => {
+    finishRun(lookUpRun(getArguments({ numberOfSimulations: 1000 })), 1000, 10, 0.01, 5, played(1000));
+    const args = getArguments({ numberOfSimulations: 4000 });
+    const lookup = lookUpRun(args);
+    expect(lookup.status).toEqual('topUp');
+    expect(args[6].continueState).toEqual(Buffer.from([1000 % 256]));
+    expect(finishRun(lookup, 4000, 40, 0.01, 5, played(4000)).cache).toEqual({ status: 'topUp', reusedHands: 1000, reuseFraction: 0.25 });
+    expect(lookUpRun(getArguments({ numberOfSimulations: 4000 })).status).toEqual('hit');
+  });
+
+  it('should play fewer hands than were kept afresh and keep the longer run', () => {
+    finishRun(lookUpRun(getArguments({ numberOfSimulations: 4000 })), 4000, 40, 0.01, 5, played(4000));
+    const args = getArguments({ numberOfSimulations: 1000 });
+    const lookup = lookUpRun(args);
+    expect(lookup.status).toEqual('miss');
+    expect(args[6].continueState).toBeUndefined();
+    finishRun(lookup, 1000, 10, 0.01, 5, played(1000));
+    expect(lookUpRun(getArguments({ numberOfSimulations: 4000 })).status).toEqual('hit');
+  });
+
+  it('should not keep runs that stopped early', () => {
+    const lookup = lookUpRun(getArguments({ numberOfSimulations: 1000 }));
+    finishRun(lookup, 1000, 5, 0.01, 5, { ...played(500), stopReason: 'cancelled' });
+    expect(lookUpRun(getArguments({ numberOfSimulations: 1000 })).status).toEqual('miss');
+  });
+
+  it('should key runs by their confidence', () => {
+    finishRun(lookUpRun(getArguments({ numberOfSimulations: 1000 })), 1000, 10, 0.01, 5, played(1000));
+    expect(lookUpRun(getArguments({ numberOfSimulations: 1000, confidence: 0.99 })).status).toEqual('miss');
+  });
+
+  it('should bypass exact runs, checkpoints, shards, precision targets and time limits', () => {
+    const bodies = [{ mode: 'exact' }, { checkpoint: 'uth-spec-cache' }, { targetHalfWidth: 0.01 }, { targetStDevHalfWidth: 1 }, { timeLimitMs: 1000 }];
+    for (const body of bodies) {
+      const args = getArguments({ numberOfSimulations: 1000, ...body });
+      expect(lookUpRun(args).status).toEqual('bypass');
+      expect(args[6].returnState).toBeUndefined();
+    }
+    const sharded = getArguments({ numberOfSimulations: 1000 });
+    sharded[6].shard = { index: 0, count: 2 };
+    expect(lookUpRun(sharded).status).toEqual('bypass');
+  });
+});
+
+describe('NUMA replicas', () => {
+  it('should split the hands between the nodes only with a copy on each', (done) => {
+    binding.runUthSimulations([], 200000, 100, 0, 0, 0, false, { seed: 5 }, (profit, edge, stDev, cards) => {
+      const status = binding.getSimulationStatus();
+      if (!status.handRanksNumaNodes) {
+        expect(cards.numaNodes).toBeUndefined();
+        done();
+        return;
+      }
+      expect(cards.numaNodes!.length).toEqual(status.handRanksNumaNodes);
+      expect(cards.numaNodes!.reduce((sum, node) => sum + node.hands, 0)).toEqual(200000);
+      done();
+    });
+  });
+});
+
+describe('Outs engine', () => {
+  it('should count the same outs with either evaluator and report its cache', (done) => {
+    binding.runUthSimulations([], 200000, 100, 1, 1, 0, false, { seed: 5 }, (profit, edge, stDev, cards) => {
+      binding.runUthSimulations([], 200000, 100, 1, 1, 0, false, { seed: 5, evaluator: 'compact' }, (profit2, edge2, stDev2, compact) => {
+        expect(edge2).toEqual(edge);
+        const cache = compact.outsCache!;
+        expect(cache.lookups).toBeGreaterThan(0);
+        expect(cache.hits).toBeLessThanOrEqual(cache.lookups);
+        // The cache fills on first use and stays filled between runs
+        expect(cache.hitRate).toBeGreaterThan(0.9);
+        done();
+      });
+    });
+  });
+});
+
+describe('Hand EVs', () => {
+  it('should give the profit of each action on a fully known river', (done) => {
+    binding.getHandEvs(cnToInt(['2c', '7d', '9h', 'Js', '3c', 'As', 'Ad', 'Kc', 'Qd']), 0, 0, 0, false, {}, (evs) => {
+      expect(evs.error).toEqual('');
+      expect(evs.street).toEqual('river');
+      expect(evs.deals).toEqual(1);
+      expect(evs.evs).toEqual({ call1x: 1, fold: -2 });
+      expect(evs.strategyAction).toEqual('call1x');
+      done();
+    });
+  });
+
+  it('should enumerate every completion behind a known dealer card', (done) => {
+    const cards = [...cnToInt(['2d']), 0, 0, 0, 0, ...cnToInt(['Ks', '7s', '9h']), 0];
+    binding.getHandEvs(cards, 1, 1, 0, false, {}, (evs) => {
+      expect(evs.street).toEqual('preflop');
+      expect(evs.deals).toEqual(48 * 47 * 46 * 45 * 44);
+      expect(evs.evs.raise4x).toBeGreaterThan(evs.evs.check);
+      expect(evs.strategyAction).toEqual('raise4x');
+      // Checking hands the flop and river to the strategy, which here never bets
+      binding.getHandEvs(cards, 1, 1, 0, false, { strategy: 'preflop: 33+' }, (custom) => {
+        expect(custom.evs.raise4x).toEqual(evs.evs.raise4x);
+        expect(custom.evs.check).toEqual(-2);
+        expect(custom.strategyAction).toEqual('check');
+        done();
+      });
+    });
+  });
+
+  it('should need the cards the scenario shows the player', (done) => {
+    binding.getHandEvs([0, 0, 0, 0, 0, ...cnToInt(['Ks', '7s', '9h']), 0], 1, 1, 0, false, {}, (evs) => {
+      expect(evs.error).not.toEqual('');
+      done();
+    });
+  });
+});
+
+describe('Strategy optimizer', () => {
+  it('should pick the best threshold on common deals and check it on fresh ones', (done) => {
+    const options = { strategy: 'river: twoPair hiddenPair outsBelow({outs=21})', parameters: { outs: [17, 19, 21, 23, 25] }, seed: 5 };
+    binding.optimizeStrategy(200000, 0, 0, 0, false, options, (optimized) => {
+      expect(optimized.error).toEqual('');
+      expect(optimized.baselineStrategy).toEqual('river: twoPair hiddenPair outsBelow(21)');
+      const outs = optimized.parameters[0];
+      expect(outs.candidates.length).toEqual(5);
+      expect(optimized.strategy).toEqual(`river: twoPair hiddenPair outsBelow(${outs.value})`);
+      // The search stopped on the winner, so no candidate is surely better
+      expect(Math.max(...outs.candidates.map(c => c.difference - c.halfWidth))).toBeLessThanOrEqual(0);
+      expect(optimized.difference).toBeGreaterThanOrEqual(0);
+      expect(optimized.validation.hands).toEqual(200000);
+      expect(optimized.validation.edgeHalfWidth).toBeGreaterThan(0);
+      done();
+    });
+  });
+
+  it('should only move to a value whose whole interval is better', (done) => {
+    const options = { parameters: { fishy: ['7', '8', '9'], flopOuts: [12], goodOuts: ['4', '5', '6', '7', '8', '9'], goodOrPushOuts: [15] }, seed: 5 };
+    binding.optimizeStrategy(200000, 1, 1, 0, true, options, (optimized) => {
+      expect(optimized.error).toEqual('');
+      for (const parameter of optimized.parameters) {
+        const kept = parameter.candidates.find(c => c.value === parameter.value);
+        expect(kept.difference).toEqual(0);
+        for (const candidate of parameter.candidates) {
+          expect(candidate.difference - candidate.halfWidth).toBeLessThanOrEqual(0);
+        }
+      }
+      // 7 good outs comes out ahead on these deals, but by less than its noise
+      const goodOuts = optimized.parameters.find(p => p.name === 'goodOuts');
+      expect(goodOuts.value).toEqual('8');
+      expect(goodOuts.candidates.find(c => c.value === '7').difference).toBeGreaterThan(0);
+      done();
+    });
+  });
+
+  it('should reject parameters missing from the strategy', (done) => {
+    binding.optimizeStrategy(1000, 0, 0, 0, false, { strategy: 'river: outsBelow({outs=21})', parameters: { flopOuts: [12] } }, (optimized) => {
+      expect(optimized.error).not.toEqual('');
+      done();
+    });
+  });
+});
+
+describe('Profiling', () => {
+  it('should count every play bet only in builds with UTH_PROFILE', (done) => {
+    binding.runUthSimulations([], 100000, 100, 1, 1, 0, false, { seed: 5 }, (profit, edge, stDev, cards) => {
+      if (!cards.profile) {
+        done();
+        return;
+      }
+      const bets = cards.profile.playBets;
+      expect(bets.raise4x + bets.bet2x + bets.call1x + bets.fold).toEqual(100000);
+      expect(cards.profile.goodOuts.earlyExits).toBeLessThanOrEqual(cards.profile.goodOuts.calls);
+      expect(cards.profile.sampledHands).toBeGreaterThan(0);
+      done();
+    });
+  });
+});
@@ -6,7 +6,7 @@ import { PokerEvalService } from './services/pokerEval.service';
 
 describe('AppComponent', () => {
   beforeEach(async () => {
-    const pokerEvalService = jasmine.createSpyObj('PokerEvalService', ['runUthSimulations']);
+    const pokerEvalService = jasmine.createSpyObj('PokerEvalService', ['runUthSimulations', 'streamUthSimulations']);
     pokerEvalService.runUthSimulations.and.returnValue(of({
       playerCards: [],
       communityCards: [],
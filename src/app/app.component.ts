@@ -1,7 +1,7 @@
 import { CurrencyPipe } from '@angular/common';
 import { Component, OnDestroy, OnInit } from '@angular/core';
 import { AbstractControl, FormBuilder, FormControl, FormGroup, Validators } from '@angular/forms';
-import { interval, Subject } from 'rxjs';
+import { Subject } from 'rxjs';
 import { takeUntil } from 'rxjs/operators';
 import { SimulationResults, SimulationStatus } from './models/simulationResults';
 import { PokerEvalService } from './services/pokerEval.service';
@@ -23,9 +23,6 @@ export class AppComponent implements OnInit, OnDestroy {
   errorMessage = '';
   profitPerSession = 0;
   stDevPct = 0;
-  lastProgressUpdate = 0; // Track last progress to prevent race conditions
-  lastProgressTime = 0; // Track when last progress was received
-  progressRate = 0; // Track rate of progress for interpolation
 
   constructor(private fb: FormBuilder, private pokerEvalService: PokerEvalService) { }
 
@@ -59,73 +56,37 @@ export class AppComponent implements OnInit, OnDestroy {
         currentSimulationNumber: 0,
         numberOfSimulations: numberOfSimulations
       }
-      this.lastProgressUpdate = 0; // Reset progress tracking
-      this.lastProgressTime = Date.now(); // Reset time tracking
-      this.progressRate = 0; // Reset progress rate
-      
-      // Use simple fixed polling with race condition prevention
-      const simulationStatus$ = interval(3000).pipe(takeUntil(this.simulationCompleted)).subscribe(() => {
-        this.pokerEvalService.getSimulationStatus().subscribe((simulationStatus) => {
-          // Only update if the new progress is higher than the last update (prevents race conditions)
-          if (simulationStatus.currentSimulationNumber >= this.lastProgressUpdate) {
-            // Calculate progress rate for interpolation
-            const currentTime = Date.now();
-            const timeDiff = currentTime - this.lastProgressTime;
-            const progressDiff = simulationStatus.currentSimulationNumber - this.lastProgressUpdate;
-            
-            if (timeDiff > 0 && progressDiff > 0) {
-              this.progressRate = progressDiff / timeDiff; // Rate: simulations per millisecond
-            }
-            
-            this.simulationStatus = simulationStatus;
-            this.lastProgressUpdate = simulationStatus.currentSimulationNumber;
-            this.lastProgressTime = currentTime;
-          }
-        })
-      });
-      
-      // Client-side progress interpolation for smoother UI
-      const interpolationInterval$ = interval(100).pipe(takeUntil(this.simulationCompleted)).subscribe(() => {
-        if (this.simulationStatus && this.progressRate > 0 && this.lastProgressUpdate < this.simulationStatus.numberOfSimulations) {
-          const currentTime = Date.now();
-          const timeSinceLastUpdate = currentTime - this.lastProgressTime;
-          
-          // Estimate current progress based on rate
-          const estimatedProgress = Math.min(
-            this.lastProgressUpdate + (this.progressRate * timeSinceLastUpdate),
-            this.simulationStatus.numberOfSimulations
-          );
-          
-          // Update display with interpolated progress
-          this.simulationStatus = {
-            currentSimulationNumber: Math.floor(estimatedProgress),
-            numberOfSimulations: this.simulationStatus.numberOfSimulations
-          };
-        }
-      });
-      
+
       const start = window.performance.now();
-      this.pokerEvalService.runUthSimulations(numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays).subscribe((simulationResults) => {
-        this.profitPerSession = simulationResults.edge * handsPerSession;
-        this.stDevPct = simulationResults.stDev / handsPerSession;
-        this.simulation = simulationResults;
-        const end = window.performance.now();
-        this.executionTime = end - start;
-        this.convertExecutionTime();
-        this.loading = false;
-        simulationStatus$.unsubscribe();
-        interpolationInterval$.unsubscribe();
-      }, (errorResp) => {
-        this.simulationStatus = undefined;
-        this.submitted = false;
-        this.loading = false;
-        this.errorMessage = errorResp && errorResp.error && errorResp.error.message || 'Server Error';
-        simulationStatus$.unsubscribe();
-        interpolationInterval$.unsubscribe();
-      });
+      // The worker pushes progress and a running estimate until the result arrives
+      this.pokerEvalService.streamUthSimulations(numberOfSimulations, handsPerSession, knownDealerCards, knownFlopCards, knownTurnRiverCards, excludeFishyPlays)
+        .pipe(takeUntil(this.simulationCompleted)).subscribe((event) => {
+          if (event.type === 'progress') {
+            this.simulationStatus = event;
+          } else if (event.type === 'result') {
+            this.profitPerSession = event.edge * handsPerSession;
+            this.stDevPct = event.stDev / handsPerSession;
+            this.simulation = event;
+            const end = window.performance.now();
+            this.executionTime = end - start;
+            this.convertExecutionTime();
+            this.loading = false;
+          } else {
+            this.showError(event.message);
+          }
+        }, (errorResp) => {
+          this.showError(errorResp && errorResp.error && errorResp.error.message || 'Server Error');
+        });
     }
   }
 
+  showError(message: string) {
+    this.simulationStatus = undefined;
+    this.submitted = false;
+    this.loading = false;
+    this.errorMessage = message;
+  }
+
   convertExecutionTime() {
     const diff = this.executionTime;
     const today = new Date();
@@ -5,9 +5,58 @@ export interface SimulationResults {
   profit: number;
   edge: number;
   stDev: number;
+  hands?: number;
+  exact?: boolean;
+  seed?: number;
+  allocationsPerHand?: number;
+  jobId?: number;
+  stopReason?: string;
+  edgeHalfWidth?: number;
+  stDevHalfWidth?: number;
+  sessions?: number;
+  losingSessionProbability?: number;
+  riskOfRuin?: number;
+  sessionPercentiles?: { [percentile: string]: number };
+  sessionHistogram?: { start: number, binWidth: number, counts: number[], below: number, above: number };
+  configurations?: ConfigurationResults[];
+  edgeDifferences?: { first: number, second: number, difference: number, halfWidth: number }[];
+  cache?: { status: string, reusedHands: number, reuseFraction: number };
+};
+
+export interface ConfigurationResults {
+  knownDealerCards: number;
+  knownFlopCards: number;
+  knownTurnRiverCards: number;
+  excludeFishyPlays: boolean;
+  profit: number;
+  edge: number;
+  stDev: number;
+  edgeHalfWidth: number;
 };
 
 export interface SimulationStatus {
+  jobId?: number;
+  state?: string;
+  threads?: number;
+  runningJobs?: number;
+  poolSize?: number;
   currentSimulationNumber: number;
   numberOfSimulations: number;
+  handsPerSecond?: number;
+  edge?: number;
+  stDev?: number;
+  edgeHalfWidth?: number;
+  handRanksLoaded?: boolean;
+  handRanksMapped?: boolean;
+  handRanksHugePages?: boolean;
+  handRanksNumaNodes?: number;
+  handRanksBytes?: number;
+  handRanksLoadMs?: number;
+  handRanksError?: string;
 }
+
+// One line of the streamUthSimulations response
+export type SimulationEvent =
+  | ({ type: 'progress' } & SimulationStatus)
+  | ({ type: 'result' } & SimulationResults)
+  | { type: 'error'; message: string };
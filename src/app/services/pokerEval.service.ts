@@ -1,7 +1,8 @@
-import { HttpClient } from '@angular/common/http';
+import { HttpClient, HttpDownloadProgressEvent, HttpEventType } from '@angular/common/http';
 import { Injectable } from '@angular/core';
 import { Observable } from 'rxjs';
-import { SimulationResults, SimulationStatus } from '../models/simulationResults';
+import { filter, map, mergeMap } from 'rxjs/operators';
+import { SimulationEvent, SimulationResults, SimulationStatus } from '../models/simulationResults';
 
 @Injectable({ providedIn: 'root' })
 export class PokerEvalService {
@@ -21,6 +22,31 @@ export class PokerEvalService {
       ('http://localhost:3000/api/runUthSimulations', requestBody);
   }
 
+  // Runs a simulation over the streaming route, emitting each progress event
+  // pushed by the worker and then the result. Unsubscribing cancels the run.
+  streamUthSimulations(numberOfSimulations: number, handsPerSession: number, knownDealerCards: number, knownFlopCards: number, knownTurnRiverCards: number, excludeFishyPlays: boolean): Observable<SimulationEvent> {
+    const requestBody = {
+      numberOfSimulations,
+      handsPerSession,
+      knownDealerCards,
+      knownFlopCards,
+      knownTurnRiverCards,
+      excludeFishyPlays
+    };
+    let parsedLength = 0;
+    return this.http.post('http://localhost:3000/api/streamUthSimulations', requestBody,
+      { observe: 'events', reportProgress: true, responseType: 'text' }).pipe(
+        filter((event) => event.type === HttpEventType.DownloadProgress || event.type === HttpEventType.Response),
+        map((event) => event.type === HttpEventType.Response ? event.body || '' : (event as HttpDownloadProgressEvent).partialText || ''),
+        mergeMap((text) => {
+          // Only complete lines are parsed; the rest waits for the next chunk
+          const end = text.lastIndexOf('\n') + 1;
+          const lines = end > parsedLength ? text.substring(parsedLength, end).split('\n').filter((line) => line) : [];
+          parsedLength = Math.max(parsedLength, end);
+          return lines.map((line) => JSON.parse(line) as SimulationEvent);
+        }));
+  }
+
   getSimulationStatus(): Observable<SimulationStatus> {
     const requestBody = {};
     return this.http.post<SimulationStatus>